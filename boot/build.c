@@ -54,7 +54,7 @@ static int GCC_HEADER = sizeof(struct exec);
 
 /* max nr of sectors of setup: don't change unless you also change
  * bootsect etc */
-#define SETUP_SECTS 4
+#define SETUP_SECTS 5
 
 #define STRINGIFY(x) #x
 
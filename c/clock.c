@@ -0,0 +1,112 @@
+/* clock.c : high resolution clock source
+ *
+ * Nanoseconds since boot come from the time stamp counter when the processor
+ * has one. Its rate is measured once at boot against timer 2 of the PIT,
+ * which runs at a known frequency and is free since nothing else uses the
+ * speaker. Reading the clock is then a multiply and a shift:
+ * ns = cycles * ns_mult >> NS_SHIFT. Without a time stamp counter the clock
+ * only advances once per clock tick.
+ *
+ * Called from outside:
+ *  clock_init() - Measure the time stamp counter rate against the PIT
+ *  clock_ns() - Nanoseconds since the system started
+ *  clock_hires() - Whether clock_ns() is finer than a clock tick
+ *  clock_ns_to_us() - Convert nanoseconds to microseconds
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+
+#define CALIBRATE_MS 10           /* Time the time stamp counter is measured over */
+#define CALIBRATE_COUNTS TIMER_DIV(1000 / CALIBRATE_MS)
+#define NS_SHIFT 22               /* Fraction bits of ns_mult */
+
+static bool has_tsc;
+static unsigned long long boot_tsc;
+static unsigned long tsc_khz;
+static unsigned long ns_mult;     /* Nanoseconds per cycle, scaled by 2^NS_SHIFT */
+
+static unsigned long calibrate_tsc_khz(void);
+static unsigned long div64_32(unsigned long long dividend, unsigned long divisor);
+
+/*
+ * Measure the time stamp counter rate against the PIT. Must run with
+ * interrupts disabled.
+ */
+void clock_init(void) {
+    has_tsc = cpuHasTSC();
+    if(has_tsc) {
+        tsc_khz = calibrate_tsc_khz();
+        has_tsc = tsc_khz > 0;
+    }
+
+    if(has_tsc) {
+        ns_mult = div64_32(1000000ULL << NS_SHIFT, tsc_khz);
+        boot_tsc = readTSC();
+        kprintf("Clock source: time stamp counter at %d kHz\n", tsc_khz);
+    } else {
+        kprintf("Clock source: clock ticks\n");
+    }
+}
+
+/*
+ * Nanoseconds since the system started
+ */
+unsigned long long clock_ns(void) {
+    if(!has_tsc) {
+        return (unsigned long long)get_clock_ticks() * NS_PER_CLOCK_TICK;
+    }
+
+    // Split the cycle count so each product fits in 64 bits
+    unsigned long long cycles = readTSC() - boot_tsc;
+    unsigned long hi = cycles >> 32;
+    unsigned long lo = (unsigned long)cycles;
+    return (((unsigned long long)lo * ns_mult) >> NS_SHIFT)
+        + (((unsigned long long)hi * ns_mult) << (32 - NS_SHIFT));
+}
+
+/*
+ * Whether clock_ns() is finer than a clock tick
+ */
+bool clock_hires(void) {
+    return has_tsc;
+}
+
+/*
+ * Convert nanoseconds to microseconds. The result must fit in 32 bits.
+ */
+unsigned long clock_ns_to_us(unsigned long long ns) {
+    return div64_32(ns, 1000);
+}
+
+/*
+ * Count CALIBRATE_MS on timer 2 and return the time stamp counter cycles
+ * per millisecond, which is its rate in kHz
+ */
+static unsigned long calibrate_tsc_khz(void) {
+    // Open the gate with the speaker disconnected, counting starts once the count is loaded
+    outb(TIMER_GATE_PORT, (inb(TIMER_GATE_PORT) & ~SPEAKER_DATA) | TIMER_GATE2);
+    outb(TIMER_MODE, TIMER_SEL2 | TIMER_INTTC | TIMER_16BIT);
+    outb(TIMER_CNTR2, CALIBRATE_COUNTS & 0xff);
+    outb(TIMER_CNTR2, CALIBRATE_COUNTS >> 8);
+
+    unsigned long start = (unsigned long)readTSC();
+    while(!(inb(TIMER_GATE_PORT) & TIMER_OUT2));
+    unsigned long cycles = (unsigned long)readTSC() - start;
+
+    outb(TIMER_GATE_PORT, inb(TIMER_GATE_PORT) & ~TIMER_GATE2);
+    return cycles / CALIBRATE_MS;
+}
+
+/*
+ * Divide a 64 bit number by a 32 bit one with a single divl, since there is
+ * no libgcc to do 64 bit division. The quotient must fit in 32 bits.
+ */
+static unsigned long div64_32(unsigned long long dividend, unsigned long divisor) {
+    unsigned long quotient, remainder;
+    __asm__("divl %4"
+            : "=a" (quotient), "=d" (remainder)
+            : "a" ((unsigned long)dividend), "d" ((unsigned long)(dividend >> 32)), "rm" (divisor));
+    return quotient;
+}
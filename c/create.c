@@ -2,6 +2,7 @@
  *
  * Called from outside:
  *  create() - Create a new process and push it onto ready queue
+ *  free_stack() - Free the stack of a process, keeping it for reuse if there is room
  *  idleinit() - Creates the idle process
  *  get_idleproc() - Gets the idle process and returns it
  */
@@ -15,6 +16,13 @@
 
 static pcb_t idle_process;
 
+/* Stacks of exited processes with the default size, ready for the next
+ * create() */
+static void *stack_pool[STACK_POOL_SIZE];
+static int stack_pool_count;
+
+static void *alloc_stack(int stack_order);
+
 /*
  * Create a new process by finding an available PCB, allocating stack memory,
  * and push it into ready queue.
@@ -32,34 +40,40 @@ int create(funcptr fp, int stack) {
         stack = DEFAULT_STACK_SIZE;
     }
 
-    void *stack_start = kmalloc(stack);
+    int stack_order = kpage_order(stack);
+    void *stack_start = alloc_stack(stack_order);
     if (!stack_start) {
         return CREATE_FAILURE;
     }
 
-    funcptr_args *signal_table = kmalloc(SIGNAL_TABLE_SIZE * sizeof(funcptr_args));
-    if (!signal_table) {
-        return CREATE_FAILURE;
-    }
-    memset(signal_table, 0, sizeof(SIGNAL_TABLE_SIZE * sizeof(funcptr_args)));
-
     pcb_t *new_proc = get_free_pcb();
     if (new_proc == NULL) {
         LOG("Unable to find an available PCB!\n");
-        kfree(stack_start);
-        kfree(signal_table);
+        free_stack(stack_start, stack_order);
         return CREATE_FAILURE;
     }
     
 
     // Storing this will make it easy to free the stack mem later
     new_proc->stack_start = stack_start;
+    new_proc->stack_order = stack_order;
     
-    new_proc->signal_table = signal_table;
+    // The signal table is allocated when the process sets its first handler
+    new_proc->signal_table = NULL;
     new_proc->signals_enabled = 0;
-    
-    // Every process has a signal handler installed by default to terminate the process on signal 31
-    new_proc->signal_table[KILL_SIGNAL_NUM] = (funcptr_args)&sysstop;
+    new_proc->priority = PRIORITY_DEFAULT;
+    new_proc->base_priority = PRIORITY_DEFAULT;
+    new_proc->pass = 0;
+    sched_set_tickets(new_proc, STRIDE_DEFAULT_TICKETS);
+    new_proc->rt_period = 0;
+    new_proc->rt_misses = 0;
+    new_proc->quantum = QUANTUM_DEFAULT_TICKS;
+    new_proc->quantum_left = QUANTUM_DEFAULT_TICKS;
+    new_proc->involuntary_switches = 0;
+    new_proc->ipc_partner = 0;
+    new_proc->ring = NULL;
+    new_proc->ring_parked = FALSE;
+    new_proc->ring_done = 0;
 
     // Set the address of sysstop() as the return address of this process
     sysstop_return_addr =
@@ -76,19 +90,45 @@ int create(funcptr fp, int stack) {
     return new_proc->pid;
 }
 
+/*
+ * Allocate a stack of 2^stack_order pages, reusing a pooled one for the
+ * default size.
+ * Returns null if out of memory.
+ */
+static void *alloc_stack(int stack_order) {
+    if (stack_order == kpage_order(DEFAULT_STACK_SIZE) && stack_pool_count > 0) {
+        return stack_pool[--stack_pool_count];
+    }
+    return kpage_alloc(stack_order);
+}
+
+/*
+ * Free the stack of a process. Default sized stacks go back to the pool
+ * while it has room.
+ */
+void free_stack(void *stack_start, int stack_order) {
+    if (stack_order == kpage_order(DEFAULT_STACK_SIZE) && stack_pool_count < STACK_POOL_SIZE) {
+        stack_pool[stack_pool_count++] = stack_start;
+        return;
+    }
+    kpage_free(stack_start);
+}
+
 /*
  * Creates the idle process
  */
 int idleinit(void) {
     funcptr *sysstop_return_addr;
 
-    void *stack_start = kmalloc(IDLE_PROC_STACK_SIZE);
+    int stack_order = kpage_order(IDLE_PROC_STACK_SIZE);
+    void *stack_start = kpage_alloc(stack_order);
     if (!stack_start) {
         return CREATE_FAILURE;
     }
 
     // Storing this will make it easy to free the stack mem later
     idle_process.stack_start = stack_start;
+    idle_process.stack_order = stack_order;
 
     // Set the address of sysstop() as the return address of this process
     sysstop_return_addr =
@@ -104,6 +144,10 @@ int idleinit(void) {
     idle_process.pid = 0;
     idle_process.blocked_id = 0;
     idle_process.cpu_time = 0;
+    idle_process.priority = PRIORITY_LOWEST;
+    idle_process.base_priority = PRIORITY_LOWEST;
+    idle_process.quantum = 1;
+    idle_process.quantum_left = 1;
     idle_process.blocked_status = BLOCKED_STATUS_NONE;
     idle_process.state = PROC_STATE_READY;
     return 0;
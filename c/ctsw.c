@@ -3,16 +3,32 @@
  * Called from outside:
  *  contextinit() - Initializes irq handlers that enable entry to the context switcher
  *  contextswitch() - Switch context from the kernel to the user process
+ *
+ * Syscalls enter either through the SYSCALL_INT_NUM gate or, on cpus that
+ * have it, with sysenter. The sysenter stub in syscall() pushes the same
+ * eflags/cs/eip frame the gate would and passes its stack pointer in %ebp,
+ * so both paths leave an identical context_frame_t and return with iret.
+ * sysexit can't be used since it always drops to ring 3 and processes run
+ * in ring 0.
+ *
+ * The sysenter path saves every register with pusha, like the gate, rather
+ * than only the callee-saved ones. A process may be resumed by a signal or
+ * after a preemption whichever way it entered, and signal delivery builds
+ * its frames on the saved context_frame_t, so a second, slimmer frame layout
+ * would have to be told apart on every one of those paths. What sysenter
+ * saves is the gate lookup and privilege checks of int.
  */
 
 #include <xeroskernel.h>
 #include <pcb.h>
+#include <i386.h>
 
 #define CTSW_TYPE_SYSCALL 0
 #define CTSW_TYPE_TIMER 1
 #define CTSW_TYPE_KEYBOARD 2
 
 void _syscall_entry_point(void);
+void _sysenter_entry_point(void);
 void _timer_entry_point(void);
 void _common_entry_point(void);
 void _keyboard_entry_point(void);
@@ -20,17 +36,30 @@ void _keyboard_entry_point(void);
 static void *kern_stack_ptr;
 static unsigned long *ESP;
 static unsigned long rc;
-static long args;
 static int ctsw_type;
 context_frame_t *cf;
 
+/* Entry path syscall() takes, SYSCALL_ENTRY_INT or SYSCALL_ENTRY_SYSENTER */
+int syscall_entry = SYSCALL_ENTRY_INT;
+
+/* sysenter needs a stack to load, but the entry point switches off it at once */
+static unsigned long sysenter_stack[16];
+
 /**
- * Sets the syscall interrupt handler
+ * Sets the syscall interrupt handler, and the sysenter entry point if the
+ * cpu supports it
  */
 void contextinit(void) {
     set_evec(SYSCALL_INT_NUM, (unsigned long)_syscall_entry_point);
     set_evec(TIMER_INT_NUM, (unsigned long)_timer_entry_point);
     set_evec(KEYBOARD_INT_NUM, (unsigned long)_keyboard_entry_point);
+
+    if (cpuHasSysenter()) {
+        writeMSR(MSR_SYSENTER_CS, KERNEL_CODE_SEL, 0);
+        writeMSR(MSR_SYSENTER_ESP, (unsigned long)&sysenter_stack[16], 0);
+        writeMSR(MSR_SYSENTER_EIP, (unsigned long)_sysenter_entry_point, 0);
+        syscall_entry = SYSCALL_ENTRY_SYSENTER;
+    }
 }
 
 /*
@@ -78,17 +107,20 @@ syscall_request_t contextswitch(pcb_t *proc) {
         cli \n\
         pusha  \n\
         movl $0, ctsw_type \n\
+        jmp _common_entry_point \n\
+    _sysenter_entry_point: \n\
+        movl %%ebp, %%esp \n\
+        pusha \n\
+        movl $0, ctsw_type \n\
    _common_entry_point: \n\
         movl    %%eax, %%ebx \n\
         movl    ESP, %%eax  \n\
         movl    %%esp, ESP  \n\
         movl    %%eax, %%esp  \n\
         movl    %%ebx, 28(%%esp) \n\
-        movl    %%edx, 20(%%esp) \n\
         popa \n\
         popf \n\
         movl    %%eax, rc \n\
-        movl    %%edx, args \n\
         "
         : 
         : 
@@ -101,8 +133,13 @@ syscall_request_t contextswitch(pcb_t *proc) {
 
     switch(ctsw_type) {
         case CTSW_TYPE_SYSCALL:
+            // The arguments are still in the registers saved on the process stack
             proc->ret = rc;
-            proc->args = args;
+            proc->args[0] = cf->ebx;
+            proc->args[1] = cf->ecx;
+            proc->args[2] = cf->edx;
+            proc->args[3] = cf->esi;
+            proc->args[4] = cf->edi;
             break;
         case CTSW_TYPE_TIMER:
             rc = TIMER_INT;
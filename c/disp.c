@@ -7,30 +7,111 @@
 
 #include <xeroskernel.h>
 #include <pcb.h>
-#include <stdarg.h>
 #include <kbd.h>
 #include <i386.h>
 
-static int handle_syscall_create(void);
+static void handle_syscall_create(void);
+static void handle_syscall_createmany(void);
+static void handle_syscall_yield(void);
+static void handle_syscall_stop(void);
+static void handle_syscall_getpid(void);
 static void handle_syscall_puts(void);
-static int handle_syscall_kill(void);
-static int handle_syscall_send(void);
-static int handle_syscall_recv(void);
+static void handle_syscall_kill(void);
+static void handle_syscall_send(void);
+static void handle_syscall_recv(void);
+static void handle_syscall_sendtim(void);
+static void handle_syscall_recvtim(void);
+static void handle_syscall_sendnb(void);
+static void handle_syscall_recvnb(void);
+static void handle_syscall_sendasync(void);
+static void handle_syscall_mailbox(void);
+static void handle_syscall_mailboxstats(void);
+static void handle_syscall_regionalloc(void);
+static void handle_syscall_regionfree(void);
+static void handle_syscall_sendregion(void);
+static void send_request(syscall_request_t request);
+static void recv_request(syscall_request_t request);
+static void handle_syscall_sendrecv(void);
+static void handle_syscall_replywait(void);
 static void handle_syscall_sleep(void);
-static int handle_syscall_cputimes(void);
+static void handle_syscall_usleep(void);
+static void handle_syscall_gettimens(void);
+static void handle_syscall_cputimes(void);
 static void handle_syscall_wait(void);
-static int handle_syscall_sighandler(void);
+static void handle_syscall_sighandler(void);
 static void handle_syscall_sigreturn(void);
 static void handle_syscall_open(void);
 static void handle_syscall_close(void);
 static void handle_syscall_write(void);
 static void handle_syscall_read(void);
 static void handle_syscall_ioctl(void);
+static void handle_syscall_setprio(void);
+static void handle_syscall_getprio(void);
+static void handle_syscall_schedstats(void);
+static void handle_syscall_settickets(void);
+static void handle_syscall_setrt(void);
+static void handle_syscall_setquantum(void);
+static void handle_syscall_ringsetup(void);
+static void handle_syscall_ringenter(void);
+static bool ring_request_allowed(int request);
+static void ring_complete(pcb_t *pcb, int result);
+static void handle_timer_int(void);
+static void handle_keyboard_int(void);
+static unsigned int ms_to_ticks(unsigned int milliseconds);
+static void account_tick(pcb_t *pcb);
+static void preempt_running(void);
+static bool keeps_ipc_partner(syscall_request_t request);
+static pcb_t *take_ipc_partner(pcb_t *pcb);
 
 static pcb_t *process;
-static funcptr fp;
-static va_list args;
-static int ptr_check;
+
+/* Handler of every request, indexed by syscall_request_t */
+static const funcptr request_handlers[NUM_REQUESTS] = {
+    [SYSCALL_CREATE] = handle_syscall_create,
+    [SYSCALL_YIELD] = handle_syscall_yield,
+    [SYSCALL_STOP] = handle_syscall_stop,
+    [SYSCALL_GETPID] = handle_syscall_getpid,
+    [SYSCALL_PUTS] = handle_syscall_puts,
+    [SYSCALL_KILL] = handle_syscall_kill,
+    [SYSCALL_RECV] = handle_syscall_recv,
+    [SYSCALL_SEND] = handle_syscall_send,
+    [SYSCALL_SLEEP] = handle_syscall_sleep,
+    [SYSCALL_CPUTIMES] = handle_syscall_cputimes,
+    [SYSCALL_SIGHANDLER] = handle_syscall_sighandler,
+    [SYSCALL_SIGRETURN] = handle_syscall_sigreturn,
+    [SYSCALL_WAIT] = handle_syscall_wait,
+    [SYSCALL_OPEN] = handle_syscall_open,
+    [SYSCALL_CLOSE] = handle_syscall_close,
+    [SYSCALL_WRITE] = handle_syscall_write,
+    [SYSCALL_READ] = handle_syscall_read,
+    [SYSCALL_IOCTL] = handle_syscall_ioctl,
+    [SYSCALL_SETPRIO] = handle_syscall_setprio,
+    [SYSCALL_GETPRIO] = handle_syscall_getprio,
+    [SYSCALL_SCHEDSTATS] = handle_syscall_schedstats,
+    [SYSCALL_SETTICKETS] = handle_syscall_settickets,
+    [SYSCALL_SETRT] = handle_syscall_setrt,
+    [SYSCALL_SETQUANTUM] = handle_syscall_setquantum,
+    [SYSCALL_SENDRECV] = handle_syscall_sendrecv,
+    [SYSCALL_REPLYWAIT] = handle_syscall_replywait,
+    [SYSCALL_RINGSETUP] = handle_syscall_ringsetup,
+    [SYSCALL_RINGENTER] = handle_syscall_ringenter,
+    [SYSCALL_CREATEMANY] = handle_syscall_createmany,
+    [SYSCALL_GETTIMENS] = handle_syscall_gettimens,
+    [SYSCALL_USLEEP] = handle_syscall_usleep,
+    [SYSCALL_SENDTIM] = handle_syscall_sendtim,
+    [SYSCALL_RECVTIM] = handle_syscall_recvtim,
+    [SYSCALL_SENDNB] = handle_syscall_sendnb,
+    [SYSCALL_RECVNB] = handle_syscall_recvnb,
+    [SYSCALL_SENDASYNC] = handle_syscall_sendasync,
+    [SYSCALL_MAILBOX] = handle_syscall_mailbox,
+    [SYSCALL_MAILBOXSTATS] = handle_syscall_mailboxstats,
+    [SYSCALL_REGIONALLOC] = handle_syscall_regionalloc,
+    [SYSCALL_REGIONFREE] = handle_syscall_regionfree,
+    [SYSCALL_SENDREGION] = handle_syscall_sendregion,
+    [TIMER_INT] = handle_timer_int,
+    [KEYBOARD_INT] = handle_keyboard_int,
+};
+
 /**
  * Initialize the dispatcher and pcb related items
  */
@@ -50,103 +131,40 @@ void dispatch(void) {
             process = get_idleproc();
         }
 
-        syscall_request_t request = contextswitch(process);
-        switch(request) {
-            case SYSCALL_CREATE:
-                process->ret = handle_syscall_create();
-                break;
-            
-            case SYSCALL_YIELD:
-                add_pcb_to_ready_queue(process);
-                process = get_next_pcb();
-                break;
-            
-            case SYSCALL_STOP:
-                cleanup_pcb(process);
-                process = get_next_pcb();
-                break;
-            
-            case SYSCALL_GETPID:
-                process->ret = process->pid;
-                break;
-            
-            case SYSCALL_KILL:
-                process->ret = handle_syscall_kill();
-                break;
-            
-            case SYSCALL_PUTS:
-                handle_syscall_puts();
-                break;
-           
-            case SYSCALL_SEND:
-                process->ret = handle_syscall_send();
-                break;
-            
-            case SYSCALL_RECV:
-                process->ret = handle_syscall_recv();
-                break;
-
-            case SYSCALL_SLEEP:
-                handle_syscall_sleep();
-                process = get_next_pcb();
-                break;
-            
-            case SYSCALL_CPUTIMES:
-                process->ret = handle_syscall_cputimes();
-                break;
-
-            case SYSCALL_SIGHANDLER:
-                process->ret = handle_syscall_sighandler();
-                break;
-
-            case SYSCALL_SIGRETURN:
-                handle_syscall_sigreturn();
-                break;
-
-            case SYSCALL_WAIT:
-                handle_syscall_wait();
-                break;
-
-            case SYSCALL_OPEN:
-                handle_syscall_open();
-                break;
-
-            case SYSCALL_CLOSE:
-                handle_syscall_close();
-                break;
-            
-            case SYSCALL_WRITE:
-                handle_syscall_write();
-                break;
-
-            case SYSCALL_READ:
-                handle_syscall_read();
-                break;
-
-            case SYSCALL_IOCTL:
-                handle_syscall_ioctl();
-                break;
-
-            case TIMER_INT:
-                tick();
-                process->cpu_time++;
-                if(process->pid != 0) {
-                    add_pcb_to_ready_queue(process);
+        pcb_t *prev_process = process;
+        // A ring batch carries on once its blocked request completes, before
+        // the process itself runs again
+        syscall_request_t request = SYSCALL_RINGENTER;
+        if(!process->ring_parked) {
+            // Nothing else can run, so stop the periodic tick until a sleeper is due
+            int tickless_ticks = process->pid == 0 ? tickless_enter() : 0;
+
+            kinfo_switch(process);
+            request = contextswitch(process);
+            if(tickless_ticks) {
+                int skipped = tickless_exit(request == TIMER_INT);
+                while(skipped-- > 0) {
+                    account_tick(process);
                 }
-                process = get_next_pcb();
-                end_of_intr();
-                break;
-
-            case KEYBOARD_INT:
-                keyboard_isr();
-                end_of_intr();
-                break;
-
-            default:
-                kprintf("Invalid syscall request: %d, pid=%u. Halting kernel.",
-                        request, process->pid);
-                while(1);
+            }
+        }
+
+        if((unsigned int)request >= NUM_REQUESTS || request_handlers[request] == NULL) {
+            kprintf("Invalid syscall request: %d, pid=%u. Halting kernel.",
+                    request, process->pid);
+            while(1);
+        }
+        // Only the request right after a send may hand off to its receiver
+        if(!keeps_ipc_partner(request)) {
+            process->ipc_partner = 0;
         }
+        request_handlers[request]();
+
+        // Let the scheduling policy know when a process gave up the cpu by blocking
+        if(process != prev_process && prev_process->state == PROC_STATE_BLOCKED) {
+            sched_blocked(prev_process);
+        }
+        kinfo_publish_pcb(prev_process);
     }
 }
 
@@ -154,24 +172,82 @@ void dispatch(void) {
  * Handler for the create syscall. Returns 1 if create was successful, 
  * 0 otherwise.
  */
-static int handle_syscall_create(void) {
-    args = (va_list)process->args;
-    fp = (funcptr)(va_arg(args, int));
-    int size = va_arg(args, int);
+static void handle_syscall_create(void) {
+    funcptr fp = (funcptr)process->args[0];
+    int size = process->args[1];
+
+    int ptr_check = verify_sysptr(fp, sizeof(funcptr));
+    if (ptr_check != OK) {
+        process->ret = ptr_check;
+        return;
+    }
+    process->ret = create(fp, size);
+}
+
+/**
+ * Handler for the createmany syscall. Creates up to n processes running the
+ * same function, stopping at the first failure, and stores their pids.
+ */
+static void handle_syscall_createmany(void) {
+    funcptr fp = (funcptr)process->args[0];
+    int size = process->args[1];
+    int n = process->args[2];
+    pid_t *pids = (pid_t *)process->args[3];
 
-    ptr_check = verify_sysptr(fp, sizeof(funcptr));
+    int ptr_check = verify_sysptr(fp, sizeof(funcptr));
     if (ptr_check != OK) {
-        return ptr_check;
+        process->ret = ptr_check;
+        return;
+    }
+    // Bound n first so the size of the pid array can't overflow
+    if (n <= 0 || n > PCB_TABLE_SIZE || verify_sysptr(pids, n * sizeof(pid_t)) != OK) {
+        process->ret = SYSERR;
+        return;
+    }
+
+    int created = 0;
+    while (created < n) {
+        int pid = create(fp, size);
+        if (pid == CREATE_FAILURE) {
+            break;
+        }
+        pids[created++] = pid;
+    }
+    process->ret = created;
+}
+
+/**
+ * Handler for the yield syscall. A real-time process yields to end its
+ * current job.
+ */
+static void handle_syscall_yield(void) {
+    if(process->rt_period != 0) {
+        sched_rt_job_done(process);
     }
-    return create(fp, size);
+    add_pcb_to_ready_queue(process);
+    process = get_next_pcb();
+}
+
+/**
+ * Handler for the stop syscall
+ */
+static void handle_syscall_stop(void) {
+    cleanup_pcb(process);
+    process = get_next_pcb();
+}
+
+/**
+ * Handler for the getpid syscall
+ */
+static void handle_syscall_getpid(void) {
+    process->ret = process->pid;
 }
 
 /**
  * Handler for the puts syscall. Prints the given string out to the screen.
  */
 static void handle_syscall_puts(void) {
-    args = (va_list)process->args;
-    char *str = (char*)(va_arg(args, int));
+    char *str = (char*)process->args[0];
     kprintf(str);
     process->ret = 0;
 }
@@ -180,23 +256,22 @@ static void handle_syscall_puts(void) {
  * Handler for the kill syscall.
  * Returns 0 on success, and error codes on failure.
  */
-static int handle_syscall_kill(void) {
-    args = (va_list)process->args;
-    pid_t pid = (pid_t)(va_arg(args, int));
-    int signal = va_arg(args, int);
+static void handle_syscall_kill(void) {
+    pid_t pid = (pid_t)process->args[0];
+    int signal = process->args[1];
 
     pcb_t *proc_to_signal = pid_to_pcb(pid);
 
     if (proc_to_signal == NULL) {
-        return SYSKILL_TARGET_DNE;
+        process->ret = SYSKILL_TARGET_DNE;
+        return;
     }
     
-    return set_pcb_signal(proc_to_signal, signal);
+    process->ret = set_pcb_signal(proc_to_signal, signal);
 }
 
 static void handle_syscall_wait(void) {
-    args = (va_list)process->args;
-    pid_t pid = (pid_t)va_arg(args, int);
+    pid_t pid = (pid_t)process->args[0];
 
     pcb_t *proc_to_wait_on = pid_to_pcb(pid);
     if (proc_to_wait_on == NULL || pid == 0) {
@@ -204,10 +279,10 @@ static void handle_syscall_wait(void) {
         return;
     }
     
-    // Add this process to the blocked queue as it waits on the targeted process to terminate.
+    // Add this process to the waiters of the targeted process until it terminates.
     process->blocked_status = BLOCKED_STATUS_WAITING;
     process->blocked_id = pid;
-    add_pcb_to_blocked_queue(process);
+    add_pcb_to_blocked_queue(process, proc_to_wait_on->waiters);
 
     // Setup return value to assume the target process was eventually killed
     process->ret = 0;
@@ -217,68 +292,300 @@ static void handle_syscall_wait(void) {
 /** 
  * Handler for the send syscall. Returns -1 if pid does not exist,
  * -2 if send and recv pid is the same, and -3 otherwise.
+ * If the sender blocks, its return value is set when the message is taken.
+ */
+static void handle_syscall_send(void) {
+    send_request(SYSCALL_SEND);
+}
+
+/** 
+ * Handler for the sendtim syscall. Fails like send, or with TIMEOUT if the
+ * message is not taken within the given milliseconds.
+ */
+static void handle_syscall_sendtim(void) {
+    send_request(SYSCALL_SENDTIM);
+}
+
+/** 
+ * Handler for the send_nb syscall. Fails like send, or with BLOCKERR if the
+ * receiver is not waiting for the message.
+ */
+static void handle_syscall_sendnb(void) {
+    send_request(SYSCALL_SENDNB);
+}
+
+/** 
+ * Handler for the send_async syscall. Fails like send, with SYSERR_OTHER if
+ * the message does not fit in a mailbox slot, with SYSMAILBOX_NONE if the
+ * receiver has no mailbox, or with BLOCKERR if its mailbox is full.
+ */
+static void handle_syscall_sendasync(void) {
+    send_request(SYSCALL_SENDASYNC);
+}
+
+/**
+ * Handler for sysmailbox. Gives the caller a mailbox of the given depth,
+ * or takes it away for a depth of 0.
+ * Returns 0 on success, otherwise returns error codes.
+ */
+static void handle_syscall_mailbox(void) {
+    process->ret = set_mailbox(process, process->args[0]);
+}
+
+/**
+ * Handler for sysmailboxstats. Returns 0 on success, SYSERR if the pointer
+ * is invalid, or SYSMAILBOX_NONE if the caller has no mailbox.
+ */
+static void handle_syscall_mailboxstats(void) {
+    mailboxStatuses *ms = (mailboxStatuses *)process->args[0];
+
+    if (verify_sysptr(ms, sizeof(mailboxStatuses)) != OK) {
+        process->ret = SYSERR;
+        return;
+    }
+
+    process->ret = fill_mailboxStatus(process, ms);
+}
+
+/**
+ * Handler for sysregionalloc. Returns the start of a new region owned by the
+ * caller, or NULL if it can't be allocated.
+ */
+static void handle_syscall_regionalloc(void) {
+    int len = process->args[0];
+    process->ret = len > 0 ? (int)region_alloc(process, len) : (int)NULL;
+}
+
+/**
+ * Handler for sysregionfree. Returns 0 on success, or SYSREGION_NOT_OWNER
+ * if the caller does not own a region starting at the pointer.
+ */
+static void handle_syscall_regionfree(void) {
+    process->ret = region_free(process, (void *)process->args[0]);
+}
+
+/** 
+ * Handler for the send_region syscall. Fails like send, or with
+ * SYSREGION_NOT_OWNER if the caller does not own a region starting at the
+ * pointer. The region's descriptor is sent in place of the region.
+ */
+static void handle_syscall_sendregion(void) {
+    send_request(SYSCALL_SENDREGION);
+}
+
+/**
+ * Send the message in the arguments of the running process for a send,
+ * sendtim, send_nb, send_async or send_region request
  */
-static int handle_syscall_send(void) { 
-    args = (va_list)process->args;
-    int dest_pid = va_arg(args, int);
-    void *buffer = (void*)(va_arg(args, int));
-    int buffer_len = va_arg(args, int);
+static void send_request(syscall_request_t request) {
+    int dest_pid = process->args[0];
+    void *buffer = (void*)process->args[1];
+    int buffer_len = process->args[2];
+    unsigned int milliseconds = process->args[3];
+
+    // A region is sent as its descriptor in the kernel's region table
+    if (request == SYSCALL_SENDREGION) {
+        buffer = region_owned(process, buffer);
+        buffer_len = sizeof(region_t);
+    }
 
     pcb_t *dest_proc = pid_to_pcb(dest_pid);
     if (dest_proc == NULL) {
-        return SYSPID_DNE;
+        process->ret = SYSPID_DNE;
+        return;
     }
 
     if (dest_pid == process->pid) {
-        return SYSPID_SELF;
+        process->ret = SYSPID_SELF;
+        return;
     }
 
-    if (buffer_len <= 0 || verify_sysptr(buffer, buffer_len) != OK) {
-        return SYSERR_OTHER;
+    if (request == SYSCALL_SENDREGION) {
+        if (buffer == NULL) {
+            process->ret = SYSREGION_NOT_OWNER;
+            return;
+        }
+    } else if (buffer_len <= 0 || verify_sysptr(buffer, buffer_len) != OK) {
+        process->ret = SYSERR_OTHER;
+        return;
     }
 
-    int ret = send(process, dest_proc, buffer, buffer_len);
-    if(ret == BLOCKERR) {
+    if(request == SYSCALL_SENDASYNC) {
+        process->ret = buffer_len > MAILBOX_MSG_MAX ? SYSERR_OTHER :
+            send_async(process, dest_proc, buffer, buffer_len);
+        return;
+    }
+
+    // Requests that may not block only complete if the receiver is waiting
+    if(request == SYSCALL_SENDNB || (request == SYSCALL_SENDTIM && milliseconds == 0)) {
+        int len = try_send(process, dest_proc, buffer, buffer_len);
+        process->ret = len == BLOCKERR && request == SYSCALL_SENDTIM ? TIMEOUT : len;
+        return;
+    }
+
+    if(send(process, dest_proc, buffer, buffer_len) == BLOCKERR) {
+        if(request == SYSCALL_SENDTIM) {
+            set_timeout(process, milliseconds);
+        }
         process = get_next_pcb();
-        return SYSPID_DNE;
     }
-    return ret;
 }
 
 /** 
  * Handler for the recv syscall. Returns -1 if pid does not exist,
  * -2 if send and recv pid is the same, and -3 otherwise.
+ * If the receiver blocks, its return value is set when a message arrives.
+ */
+static void handle_syscall_recv(void) {
+    recv_request(SYSCALL_RECV);
+}
+
+/** 
+ * Handler for the recvtim syscall. Fails like recv, or with TIMEOUT if no
+ * message arrives within the given milliseconds.
+ */
+static void handle_syscall_recvtim(void) {
+    recv_request(SYSCALL_RECVTIM);
+}
+
+/** 
+ * Handler for the recv_nb syscall. Fails like recv, or with BLOCKERR if no
+ * sender is waiting.
+ */
+static void handle_syscall_recvnb(void) {
+    recv_request(SYSCALL_RECVNB);
+}
+
+/**
+ * Receive into the buffer in the arguments of the running process for a
+ * recv, recvtim or recv_nb request
  */
-static int handle_syscall_recv(void) { 
-    args = (va_list)process->args;
-    int *from_pid = va_arg(args, int);
-    void *buffer = (void*)(va_arg(args, int));
-    int buffer_len = va_arg(args, int);
+static void recv_request(syscall_request_t request) {
+    pid_t *from_pid = (pid_t*)process->args[0];
+    void *buffer = (void*)process->args[1];
+    int buffer_len = process->args[2];
+    unsigned int milliseconds = process->args[3];
+    pcb_t *partner = take_ipc_partner(process);
     
-    if (verify_sysptr(from_pid, sizeof(int)) != OK) {
-        return SYSERR_OTHER;
+    if (verify_sysptr(from_pid, sizeof(pid_t)) != OK) {
+        process->ret = SYSERR_OTHER;
+        return;
     }
 
     pcb_t *from_proc = pid_to_pcb(*from_pid);
     if (*from_pid != 0 && from_proc == NULL) {
-        return SYSPID_DNE;
+        process->ret = SYSPID_DNE;
+        return;
     }
 
     if (*from_pid == process->pid) {
-        return SYSPID_SELF;
+        process->ret = SYSPID_SELF;
+        return;
     }
 
     if (buffer_len <= 0 || verify_sysptr(buffer, buffer_len) != OK) {
-        return SYSERR_OTHER;
+        process->ret = SYSERR_OTHER;
+        return;
+    }
+
+    // Requests that may not block only complete if a sender is waiting
+    if(request == SYSCALL_RECVNB || (request == SYSCALL_RECVTIM && milliseconds == 0)) {
+        int len = try_recv(from_proc, process, from_pid, buffer, buffer_len);
+        process->ret = len == BLOCKERR && request == SYSCALL_RECVTIM ? TIMEOUT : len;
+        return;
     }
 
-    int ret = recv(from_proc, process, buffer, buffer_len);
+    if(recv(from_proc, process, from_pid, buffer, buffer_len) == BLOCKERR) {
+        if(request == SYSCALL_RECVTIM) {
+            set_timeout(process, milliseconds);
+        }
+        // Usually the partner was just sent a request or reply by us, so run it directly
+        process = sched_handoff(process, from_proc != NULL ? from_proc : partner);
+    }
+}
+
+/** 
+ * Handler for the sendrecv syscall. Returns -1 if pid does not exist,
+ * -2 if the destination is the caller, and -3 otherwise.
+ * The caller always blocks, its return value is set when the reply arrives.
+ */
+static void handle_syscall_sendrecv(void) {
+    int dest_pid = process->args[0];
+    void *send_buffer = (void*)process->args[1];
+    int send_len = process->args[2];
+    void *recv_buffer = (void*)process->args[3];
+    int recv_len = process->args[4];
+
+    pcb_t *dest_proc = pid_to_pcb(dest_pid);
+    if (dest_proc == NULL) {
+        process->ret = SYSPID_DNE;
+        return;
+    }
+
+    if (dest_pid == process->pid) {
+        process->ret = SYSPID_SELF;
+        return;
+    }
+
+    if (send_len <= 0 || verify_sysptr(send_buffer, send_len) != OK
+            || recv_len <= 0 || verify_sysptr(recv_buffer, recv_len) != OK) {
+        process->ret = SYSERR_OTHER;
+        return;
+    }
+
+    sendrecv(process, dest_proc, send_buffer, send_len, recv_buffer, recv_len);
+    process = sched_handoff(process, dest_proc);
+}
+
+/** 
+ * Handler for the replywait syscall. Returns -1 if the client does not exist,
+ * -2 if the client is the caller, and -3 otherwise.
+ * If the caller blocks, its return value is set when the next request arrives.
+ */
+static void handle_syscall_replywait(void) {
+    pid_t *client_pid = (pid_t*)process->args[0];
+    void *reply = (void*)process->args[1];
+    int reply_len = process->args[2];
+    void *buffer = (void*)process->args[3];
+    int buffer_len = process->args[4];
+
+    if (verify_sysptr(client_pid, sizeof(pid_t)) != OK) {
+        process->ret = SYSERR_OTHER;
+        return;
+    }
+
+    // A client pid of 0 only waits for the first request
+    pcb_t *client_proc = NULL;
+    if (*client_pid != 0) {
+        client_proc = pid_to_pcb(*client_pid);
+        if (client_proc == NULL) {
+            process->ret = SYSPID_DNE;
+            return;
+        }
+
+        if (*client_pid == process->pid) {
+            process->ret = SYSPID_SELF;
+            return;
+        }
+
+        if (reply_len <= 0 || verify_sysptr(reply, reply_len) != OK) {
+            process->ret = SYSERR_OTHER;
+            return;
+        }
+    }
+
+    if (buffer_len <= 0 || verify_sysptr(buffer, buffer_len) != OK) {
+        process->ret = SYSERR_OTHER;
+        return;
+    }
+
+    int ret = replywait(process, client_proc, reply, reply_len, client_pid, buffer, buffer_len);
     if(ret == BLOCKERR) {
-        process = get_next_pcb();
-        return SYSPID_DNE;
+        process = sched_handoff(process, take_ipc_partner(process));
+    } else {
+        take_ipc_partner(process);
+        process->ret = ret;
     }
- 
-    return ret;
 }
 
 /*
@@ -286,71 +593,101 @@ static int handle_syscall_recv(void) {
  * otherwise returns remaining time.
  */
 static void handle_syscall_sleep(void) {
-    args = (va_list)process->args;
-    unsigned int milliseconds = va_arg(args, int);
+    unsigned int milliseconds = process->args[0];
     if(milliseconds == 0) {
         process->ret = 0;
     }
     sleep(process, milliseconds);
+    process = get_next_pcb();
+}
+
+/*
+ * Handler for usleep syscall. Return 0 if sleep success,
+ * otherwise returns remaining time in microseconds.
+ */
+static void handle_syscall_usleep(void) {
+    usleep(process, process->args[0]);
+    process = get_next_pcb();
+}
+
+/*
+ * Handler for sysgettime_ns. Stores the nanoseconds since the system started.
+ * Returns 0 on success, SYSERR if the pointer is invalid.
+ */
+static void handle_syscall_gettimens(void) {
+    unsigned long long *ns = (unsigned long long *)process->args[0];
+
+    if (verify_sysptr(ns, sizeof(*ns)) != OK) {
+        process->ret = SYSERR;
+        return;
+    }
+
+    *ns = clock_ns();
+    process->ret = 0;
 }
 
 extern char* maxaddr;
 
-static int handle_syscall_cputimes() {
-  args = (va_list)process->args;
-  processStatuses *ps = va_arg(args, processStatuses *);
+static void handle_syscall_cputimes(void) {
+  processStatuses *ps = (processStatuses *)process->args[0];
   
 
   // Check if address is in the hole
-  if (((unsigned long) ps) >= HOLESTART && ((unsigned long) ps <= HOLEEND)) 
-    return -1;
+  if (((unsigned long) ps) >= HOLESTART && ((unsigned long) ps <= HOLEEND)) {
+    process->ret = -1;
+    return;
+  }
 
   //Check if address of the data structure is beyone the end of main memory
-  if ((((char *) ps) + sizeof(processStatuses)) > maxaddr)  
-    return -2;
+  if ((((char *) ps) + sizeof(processStatuses)) > maxaddr) {
+    process->ret = -2;
+    return;
+  }
 
   // There are probably other address checks that can be done, but this is OK for now
 
-  return fill_processStatus(process, ps);
+  process->ret = fill_processStatus(process, ps);
 }
 
 /**
  * Handler for syssighandler
  * Return 0 on success if handler installed, otherwise returns error codes.
  */
-static int handle_syscall_sighandler(void) { 
-    args = (va_list)process->args;
-    int signal = va_arg(args, int);
-    funcptr_args new_handler = va_arg(args, funcptr_args);
-    funcptr_args *old_handler = (funcptr_args*)va_arg(args, funcptr_args);
+static void handle_syscall_sighandler(void) {
+    int signal = process->args[0];
+    funcptr_args new_handler = (funcptr_args)process->args[1];
+    funcptr_args *old_handler = (funcptr_args*)process->args[2];
     
     if (signal < 0 || signal >= SIGNAL_TABLE_SIZE || signal == KILL_SIGNAL_NUM) {
-        return INVALID_SIGNAL;
+        process->ret = INVALID_SIGNAL;
+        return;
     }
     
     // Do pointer checks on both handler addresses. New handler is allowed to be null
     if (new_handler != NULL && verify_sysptr(new_handler, sizeof(funcptr_args)) != OK) {
-        return SYSHANDLER_NEWHANDLER_INVALID;
+        process->ret = SYSHANDLER_NEWHANDLER_INVALID;
+        return;
     }
     
     if (verify_sysptr(old_handler, sizeof(funcptr_args*)) != OK) {
-        return SYSHANDLER_OLDHANDLER_INVALID;
+        process->ret = SYSHANDLER_OLDHANDLER_INVALID;
+        return;
     }
 
     // Capture old handler and set the new one
-    *old_handler = process->signal_table[signal];
-    process->signal_table[signal] = new_handler;
-
-    return 0;
+    funcptr_args handler = get_signal_handler(process, signal);
+    process->ret = set_signal_handler(process, signal, new_handler);
+    if (process->ret == 0) {
+        *old_handler = handler;
+    }
 }
 
 /**
  * Only used by the signal trampoline code! Replaces stack pointer of process
  * with pointer of old sp passed into this function. This doesn't return.
  */
-static void handle_syscall_sigreturn(void) { 
-    args = (va_list)process->args;
-    void *old_sp = (void*)va_arg(args, int);
+static void handle_syscall_sigreturn(void) {
+    void *old_sp = (void*)process->args[0];
 
     // Ensure pointer is still valid. It could only become invalid is user modified their stack
     if (verify_sysptr(old_sp, sizeof(void*)) != OK) {
@@ -376,8 +713,7 @@ static void handle_syscall_sigreturn(void) {
  * Return fd on success, -1 on failure
  */
 static void handle_syscall_open(void) {
-    args = (va_list)process->args;
-    int device_no = va_arg(args, int);
+    int device_no = process->args[0];
 
     process->ret = di_open(process, device_no);
 }
@@ -386,9 +722,8 @@ static void handle_syscall_open(void) {
  * Handler for sysclose
  * Return 0 on success, -1 on failure
  */
-static void handle_syscall_close(void) { 
-    args = (va_list)process->args;
-    int fd = va_arg(args, int);
+static void handle_syscall_close(void) {
+    int fd = process->args[0];
     
     process->ret = di_close(process, fd);
 }
@@ -397,11 +732,10 @@ static void handle_syscall_close(void) {
  * Handler for sysread
  * Return number of bytes read on succes, -1 on failure
  */
-static void handle_syscall_read(void) { 
-    args = (va_list)process->args;
-    int fd = va_arg(args, int);
-    void *buff = (void*)va_arg(args, int);
-    int bufflen = va_arg(args, int);
+static void handle_syscall_read(void) {
+    int fd = process->args[0];
+    void *buff = (void*)process->args[1];
+    int bufflen = process->args[2];
 
     if (verify_sysptr(buff, bufflen) != OK) {
         process->ret = SYSERR;
@@ -422,10 +756,9 @@ static void handle_syscall_read(void) {
  * Return number of bytes written on succes, -1 on failure
  */ 
 static void handle_syscall_write(void) {
-    args = (va_list)process->args;
-    int fd = va_arg(args, int);
-    void *buff = (void*)va_arg(args, int);
-    int bufflen = va_arg(args, int);
+    int fd = process->args[0];
+    void *buff = (void*)process->args[1];
+    int bufflen = process->args[2];
 
     if (verify_sysptr(buff, bufflen) != OK) {
         process->ret = SYSERR;
@@ -439,13 +772,337 @@ static void handle_syscall_write(void) {
  * Handler for sysioctl
  * Return 0 on success, -1 on failure
  */
-static void handle_syscall_ioctl(void) { 
-    args = (va_list)process->args;
-    int fd = va_arg(args, int);
-    unsigned long command  = (unsigned long)(va_arg(args, long));
+static void handle_syscall_ioctl(void) {
+    int fd = process->args[0];
+    unsigned long command = process->args[1];
 
-    void *command_args = (void*)(va_arg(args, int));
+    void *command_args = (void*)process->args[2];
 
     process->ret = di_ioctl(process, fd, command, command_args);
 }
 
+
+/**
+ * Handler for syssetprio. A pid of 0 refers to the calling process.
+ * Returns the previous priority on success, otherwise returns error codes.
+ */
+static void handle_syscall_setprio(void) {
+    pid_t pid = (pid_t)process->args[0];
+    int priority = process->args[1];
+
+    pcb_t *target = pid == 0 ? process : pid_to_pcb(pid);
+    if (target == NULL) {
+        process->ret = SYSPID_DNE;
+        return;
+    }
+
+    if (priority < PRIORITY_HIGHEST || priority > PRIORITY_LOWEST) {
+        process->ret = SYSPRIO_INVALID;
+        return;
+    }
+
+    int old_priority = target->base_priority;
+    target->base_priority = priority;
+    set_pcb_priority(target, priority);
+    process->ret = old_priority;
+}
+
+/**
+ * Handler for sysgetprio. A pid of 0 refers to the calling process.
+ * Returns the priority on success, -1 if the process does not exist.
+ */
+static void handle_syscall_getprio(void) {
+    pid_t pid = (pid_t)process->args[0];
+
+    pcb_t *target = pid == 0 ? process : pid_to_pcb(pid);
+    if (target == NULL) {
+        process->ret = SYSPID_DNE;
+        return;
+    }
+
+    process->ret = target->priority;
+}
+
+/**
+ * Handler for sysgetschedstats
+ * Return 0 on success, -1 if the struct address is invalid
+ */
+static void handle_syscall_schedstats(void) {
+    schedStatuses *ss = (schedStatuses *)process->args[0];
+
+    if (verify_sysptr(ss, sizeof(schedStatuses)) != OK) {
+        process->ret = SYSERR;
+        return;
+    }
+
+    fill_schedStatus(ss);
+    process->ret = 0;
+}
+
+/**
+ * Handler for syssettickets. A pid of 0 refers to the calling process.
+ * Returns the previous ticket count on success, otherwise returns error codes.
+ */
+static void handle_syscall_settickets(void) {
+    pid_t pid = (pid_t)process->args[0];
+    int tickets = process->args[1];
+
+    pcb_t *target = pid == 0 ? process : pid_to_pcb(pid);
+    if (target == NULL) {
+        process->ret = SYSPID_DNE;
+        return;
+    }
+
+    if (tickets <= 0 || tickets > STRIDE_MAX_TICKETS) {
+        process->ret = SYSTICKETS_INVALID;
+        return;
+    }
+
+    int old_tickets = target->tickets;
+    sched_set_tickets(target, tickets);
+    process->ret = old_tickets;
+}
+
+/**
+ * Handler for syssetrt. Moves the calling process into the real-time class,
+ * or out of it if the period is 0. A deadline of 0 defaults to the period.
+ * Return 0 on success, otherwise returns error codes.
+ */
+static void handle_syscall_setrt(void) {
+    unsigned int period = ms_to_ticks(process->args[0]);
+    unsigned int budget = ms_to_ticks(process->args[1]);
+    unsigned int deadline = ms_to_ticks(process->args[2]);
+
+    if (period == 0) {
+        sched_rt_leave(process);
+        process->ret = 0;
+        return;
+    }
+
+    if (deadline == 0) {
+        deadline = period;
+    }
+
+    if (budget == 0 || budget > deadline || deadline > period) {
+        process->ret = SYSRT_INVALID;
+        return;
+    }
+
+    process->ret = sched_rt_admit(process, period, budget, deadline);
+}
+
+/**
+ * Handler for syssetquantum. A pid of 0 refers to the calling process.
+ * The new quantum applies from the next time the process is dispatched.
+ * Returns the previous quantum on success, otherwise returns error codes.
+ */
+static void handle_syscall_setquantum(void) {
+    pid_t pid = (pid_t)process->args[0];
+    int ticks = process->args[1];
+
+    pcb_t *target = pid == 0 ? process : pid_to_pcb(pid);
+    if (target == NULL) {
+        process->ret = SYSPID_DNE;
+        return;
+    }
+
+    if (ticks <= 0 || ticks > QUANTUM_MAX_TICKS) {
+        process->ret = SYSQUANTUM_INVALID;
+        return;
+    }
+
+    int old_quantum = target->quantum;
+    target->quantum = ticks;
+    process->ret = old_quantum;
+}
+
+/**
+ * Handler for sysringsetup. A null ring unregisters the current one.
+ * Return 0 on success, -1 if the ring address is invalid.
+ */
+static void handle_syscall_ringsetup(void) {
+    sysring_t *ring = (sysring_t *)process->args[0];
+
+    if (ring != NULL) {
+        if (verify_sysptr(ring, sizeof(sysring_t)) != OK) {
+            process->ret = SYSERR;
+            return;
+        }
+        ring->sq_head = ring->sq_tail = 0;
+        ring->cq_head = ring->cq_tail = 0;
+    }
+
+    process->ring = ring;
+    process->ret = 0;
+}
+
+/**
+ * Handler for sysringenter. Runs each submitted request through its handler
+ * as if the process had trapped for it, and posts its result. A request that
+ * blocks parks the batch. The dispatcher comes back here once it completes,
+ * before letting the process run.
+ * Returns the number of requests run, -1 if there is no ring or its
+ * indices are corrupt.
+ */
+static void handle_syscall_ringenter(void) {
+    pcb_t *owner = process;
+    sysring_t *ring = owner->ring;
+
+    if (ring == NULL || ring->sq_tail - ring->sq_head > SYSRING_SIZE
+            || ring->cq_tail - ring->cq_head > SYSRING_SIZE) {
+        owner->ring_parked = FALSE;
+        owner->ring_done = 0;
+        owner->ret = SYSERR;
+        return;
+    }
+
+    if (owner->ring_parked) {
+        owner->ring_parked = FALSE;
+        ring_complete(owner, owner->ret);
+    }
+
+    // Stop early rather than drop completions the process hasn't reaped
+    while (ring->sq_head != ring->sq_tail && ring->cq_tail - ring->cq_head < SYSRING_SIZE) {
+        sysring_sqe_t *sqe = &ring->sq[ring->sq_head % SYSRING_SIZE];
+        if (!ring_request_allowed(sqe->request)) {
+            ring_complete(owner, SYSRING_OP_INVALID);
+            continue;
+        }
+
+        for (int i = 0; i < SYSCALL_MAX_ARGS; i++) {
+            owner->args[i] = sqe->args[i];
+        }
+        request_handlers[sqe->request]();
+
+        if (process != owner) {
+            owner->ring_parked = TRUE;
+            return;
+        }
+        ring_complete(owner, owner->ret);
+    }
+
+    owner->ret = owner->ring_done;
+    owner->ring_done = 0;
+}
+
+/**
+ * Whether the request can run from a syscall ring. Requests that give up the
+ * cpu without blocking or manage the ring itself can't.
+ */
+static bool ring_request_allowed(int request) {
+    if (request < 0 || request >= NUM_REQUESTS || request_handlers[request] == NULL) {
+        return FALSE;
+    }
+
+    switch (request) {
+        case SYSCALL_YIELD:
+        case SYSCALL_STOP:
+        case SYSCALL_SIGRETURN:
+        case SYSCALL_RINGSETUP:
+        case SYSCALL_RINGENTER:
+        case TIMER_INT:
+        case KEYBOARD_INT:
+            return FALSE;
+        default:
+            return TRUE;
+    }
+}
+
+/**
+ * Post the result of the request at the head of the pcb's submission queue
+ * and consume it
+ */
+static void ring_complete(pcb_t *pcb, int result) {
+    sysring_t *ring = pcb->ring;
+    sysring_cqe_t *cqe = &ring->cq[ring->cq_tail % SYSRING_SIZE];
+
+    cqe->user_data = ring->sq[ring->sq_head % SYSRING_SIZE].user_data;
+    cqe->result = result;
+    ring->sq_head++;
+    ring->cq_tail++;
+    pcb->ring_done++;
+}
+
+/**
+ * Convert milliseconds to clock ticks, rounding up
+ */
+static unsigned int ms_to_ticks(unsigned int milliseconds) {
+    return milliseconds / MS_PER_CLOCK_TICK + (milliseconds % MS_PER_CLOCK_TICK ? 1 : 0);
+}
+
+/**
+ * Handler for the timer interrupt. Only rotates once the quantum is used up
+ * and someone else can run. A one-shot in between ticks only wakes usleep
+ * sleepers, which run at once if they preempt the running process.
+ */
+static void handle_timer_int(void) {
+    if(!hrtimer_interrupt()) {
+        end_of_intr();
+        if(process->pid == 0 || ready_pcb_preempts(process)) {
+            preempt_running();
+        }
+        return;
+    }
+
+    account_tick(process);
+    if(sched_quantum_tick(process)) {
+        preempt_running();
+    }
+    end_of_intr();
+}
+
+/**
+ * Whether the request may hand off to the process the caller's last send
+ * made ready. Every other request forgets it.
+ */
+static bool keeps_ipc_partner(syscall_request_t request) {
+    return request == SYSCALL_RECV || request == SYSCALL_RECVTIM || request == SYSCALL_REPLYWAIT;
+}
+
+/**
+ * Forget the process the pcb's last send made ready and return it, or null
+ * if there is none or it has exited since
+ */
+static pcb_t *take_ipc_partner(pcb_t *pcb) {
+    pid_t pid = pcb->ipc_partner;
+    pcb->ipc_partner = 0;
+    return pid != 0 ? pid_to_pcb(pid) : NULL;
+}
+
+/**
+ * Put the running process back on the ready queue and switch to the next
+ */
+static void preempt_running(void) {
+    if(process->pid != 0) {
+        add_pcb_to_ready_queue(process);
+    }
+    pcb_t *next_process = get_next_pcb();
+    if(next_process != process && process->pid != 0) {
+        sched_preempted(process);
+    }
+    process = next_process;
+}
+
+/**
+ * Handler for the keyboard interrupt. A process woken by input runs right
+ * away rather than idling to the next tick.
+ */
+static void handle_keyboard_int(void) {
+    keyboard_isr();
+    end_of_intr();
+    if(process->pid == 0) {
+        pcb_t *woken = get_next_pcb();
+        if(woken != NULL) {
+            process = woken;
+        }
+    }
+}
+
+/**
+ * Performs the per tick bookkeeping for a clock tick that pcb was running for
+ */
+static void account_tick(pcb_t *pcb) {
+    tick();
+    pcb->cpu_time++;
+    sched_tick(pcb);
+}
@@ -33,16 +33,71 @@ extern struct sd gdt[];
 long	initsp;		/* initial SP for init() */
 long    freemem;        /* start of free memory */
 char	*maxaddr;       /* end of memory space */
+mem_range_t ram_ranges[MAX_RAM_RANGES]; /* usable memory found by sizmem() */
+int     num_ram_ranges;
+
+static void add_ram_range(unsigned long long start, unsigned long long end);
 
 
 
 /*------------------------------------------------------------------------
  * sizmem - return memory size (in pages)
+ *
+ * Takes the usable memory from the map setup.S got from the BIOS, or from
+ * the extended memory size if the BIOS has no map or setup.S did not mark
+ * the map as written, and records it in ram_ranges for kmeminit(). Must run
+ * before anything overwrites the boot parameters.
  *------------------------------------------------------------------------
  */
 long sizmem(void)
 {
-        return 1024;
+	e820_entry_t	*map = BOOT_E820_MAP;
+	int		num_entries = 0;
+	unsigned long	top = 0;
+
+	/* Without the marker the count is whatever was left at 0x900a0 */
+	if (BOOT_E820_SIG == BOOT_E820_MAGIC && BOOT_E820_NR <= BOOT_E820_MAX) {
+		num_entries = BOOT_E820_NR;
+	}
+
+	num_ram_ranges = 0;
+	for (int i = 0; i < num_entries; i++) {
+		if (map[i].type == E820_RAM) {
+			add_ram_range(map[i].addr, map[i].addr + map[i].size);
+		}
+	}
+
+	if (num_ram_ranges == 0) {
+		add_ram_range(0, HOLESTART);
+		add_ram_range(1024 * 1024, (1024 + BOOT_EXT_MEM_K) * 1024);
+	}
+
+	for (int i = 0; i < num_ram_ranges; i++) {
+		if (ram_ranges[i].end > top) {
+			top = ram_ranges[i].end;
+		}
+	}
+	return top / NBPG;
+}
+
+/*------------------------------------------------------------------------
+ * add_ram_range - record the whole pages from start to end below RAM_LIMIT
+ *------------------------------------------------------------------------
+ */
+static void add_ram_range(unsigned long long start, unsigned long long end)
+{
+	if (end > RAM_LIMIT) {
+		end = RAM_LIMIT;
+	}
+	start = (start + NBPG - 1) & ~(unsigned long long)(NBPG - 1);
+	end &= ~(unsigned long long)(NBPG - 1);
+	if (start >= end || num_ram_ranges == MAX_RAM_RANGES) {
+		return;
+	}
+
+	ram_ranges[num_ram_ranges].start = start;
+	ram_ranges[num_ram_ranges].end = end;
+	num_ram_ranges++;
 }
 
 
@@ -121,6 +176,130 @@ void initPIT( int divisor )
 }
 
 
+/*------------------------------------------------------------------------
+ * initPITOneShot - interrupt once after count timer cycles, then stay quiet
+ *------------------------------------------------------------------------
+ */
+void initPITOneShot( unsigned int count )
+{
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_INTTC | TIMER_16BIT );
+        outb( TIMER_1_PORT, count & 0xff );
+        outb( TIMER_1_PORT, ( count >> 8 ) & 0xff );
+}
+
+
+/*------------------------------------------------------------------------
+ * irqPending - whether the irq is raised but not yet taken by the cpu
+ *------------------------------------------------------------------------
+ */
+int irqPending( unsigned int irq )
+{
+        unsigned int    port = irq < 8 ? ICU1 : ICU2;
+        unsigned int    irr;
+
+        outb( port, 0xa );      /* OCW3: read IRR               */
+        irr = inb( port );
+        outb( port, 0xb );      /* OCW3: back to ISR on read    */
+        return ( irr >> ( irq & 7 ) ) & 1;
+}
+
+
+/*------------------------------------------------------------------------
+ * readPIT - latch and return the current count of timer 0
+ *------------------------------------------------------------------------
+ */
+unsigned int readPIT( void )
+{
+        unsigned int    lo, hi;
+
+        outb( TIMER_MODE, TIMER_SEL0 | TIMER_LATCH );
+        lo = inb( TIMER_CNTR0 );
+        hi = inb( TIMER_CNTR0 );
+        return ( hi << 8 ) | lo;
+}
+
+
+/*------------------------------------------------------------------------
+ * cpuFeatures - cpuid 1 feature flags in edx, 0 if there is no cpuid
+ *------------------------------------------------------------------------
+ */
+static unsigned int cpuFeatures( unsigned int *signature )
+{
+        unsigned int    before, after, features;
+
+        /* cpuid exists if the ID flag can be flipped */
+        __asm__ volatile( "pushfl; popl %0; movl %0, %1; xorl %2, %1; "
+                          "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                          : "=&r" (before), "=&r" (after)
+                          : "i" (CPUID_FLAG) );
+        if( !( ( before ^ after ) & CPUID_FLAG ) ) {
+                *signature = 0;
+                return 0;
+        }
+
+        __asm__ volatile( "pushl %%ebx; cpuid; popl %%ebx"
+                          : "=a" (*signature), "=d" (features)
+                          : "a" (1)
+                          : "ecx" );
+        return features;
+}
+
+
+/*------------------------------------------------------------------------
+ * cpuHasSysenter - whether the processor supports sysenter. Early Pentium
+ * Pros report the feature but do not implement it.
+ *------------------------------------------------------------------------
+ */
+int cpuHasSysenter( void )
+{
+        unsigned int    signature;
+
+        if( !( cpuFeatures( &signature ) & CPUID_SEP ) ) {
+                return 0;
+        }
+
+        unsigned int family = ( signature >> 8 ) & 0xf;
+        unsigned int model = ( signature >> 4 ) & 0xf;
+        unsigned int stepping = signature & 0xf;
+        return !( family == 6 && model < 3 && stepping < 3 );
+}
+
+
+/*------------------------------------------------------------------------
+ * cpuHasTSC - whether the processor has a time stamp counter
+ *------------------------------------------------------------------------
+ */
+int cpuHasTSC( void )
+{
+        unsigned int    signature;
+
+        return ( cpuFeatures( &signature ) & CPUID_TSC ) != 0;
+}
+
+
+/*------------------------------------------------------------------------
+ * readTSC - the 64 bit time stamp counter
+ *------------------------------------------------------------------------
+ */
+unsigned long long readTSC( void )
+{
+        unsigned long long      tsc;
+
+        __asm__ volatile( "rdtsc" : "=A" (tsc) );
+        return tsc;
+}
+
+
+/*------------------------------------------------------------------------
+ * writeMSR - write hi:lo to a model specific register
+ *------------------------------------------------------------------------
+ */
+void writeMSR( unsigned int msr, unsigned int lo, unsigned int hi )
+{
+        __asm__ volatile( "wrmsr" : : "c" (msr), "a" (lo), "d" (hi) );
+}
+
+
 /*------------------------------------------------------------------------
  * setKbdInt - enable/disable keyboard interrupts
  *------------------------------------------------------------------------
@@ -37,6 +37,8 @@ void initproc( void )				/* The beginning */
     di_init_devtable();
     kprintf("Devices initialized!\n");
 
+    clock_init();
+
     contextinit();
     kprintf("Context switcher initialized!\n");
 
@@ -54,9 +56,22 @@ void initproc( void )				/* The beginning */
 	//run_kill_tests();
     //run_signal_tests();
     //run_device_tests();
+    //run_stride_tests();
+    //run_ipc_bench_tests();
+    //run_pingpong_tests();
+    //run_syscall_bench_tests();
+    //run_kinfo_tests();
+    //run_ring_tests();
+    //run_create_bench_tests();
+    //run_sleep_tests();
+    //run_hrtimer_tests();
+    //run_nb_server_tests();
+    //run_mailbox_tests();
+    //run_region_tests();
+    //run_rt_tests();
 
     rootinit();
-    initPIT(100);
+    initPIT(CLOCK_TICKS_PER_SECOND);
     kprintf("System initialization complete! Entering dispatcher...\n");
     dispatch();
 
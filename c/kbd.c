@@ -63,6 +63,7 @@ static int keyboard_buffer_head = 0;
 static int keyboard_buffer_tail = 0;
 static char keyboard_eof;
 static char keyboard_echo_flag; // 1 for on, 0 for off
+static kmem_cache_t *dvioblk_cache;
 
 /**
  * Fills in a device table entry with keyboard specific function.
@@ -82,8 +83,11 @@ void kbd_devsw_init(devsw_t *table_entry, int echo) {
     table_entry->dviint = &kbd_iint;
     table_entry->dvoint = &kbd_oint;
     table_entry->dvminor = echo;
-    // Note: this kmalloc will intentionally never be kfree'd
-    table_entry->dvioblk = (kbd_dvioblk_t*)kmalloc(sizeof(kbd_dvioblk_t));
+    // Note: this will intentionally never be freed
+    if (dvioblk_cache == NULL) {
+        dvioblk_cache = kmem_cache_create("kbd dvioblk", sizeof(kbd_dvioblk_t), 0);
+    }
+    table_entry->dvioblk = (kbd_dvioblk_t*)kmem_cache_alloc(dvioblk_cache);
     ASSERT(table_entry->dvioblk != NULL);
     ((kbd_dvioblk_t*)table_entry->dvioblk)->orig_echo_flag = echo;
 }
@@ -0,0 +1,60 @@
+/* kinfo.c : kernel info page
+ *
+ * The kernel publishes the running pid, the clock and a row per process in a
+ * page that user code reads directly, so sysgetpid(), sysgetticks() and
+ * sysgetcputimes() need no trap. There is no paging, so the page is only
+ * read-only by convention: user code sees it through a const pointer.
+ *
+ * The page is only written while no process runs. The generation is bumped
+ * every time the kernel returns to a process, so a reader that sees the same
+ * generation before and after copying the page has a consistent snapshot.
+ *
+ * Called from outside:
+ *  kinfo_init() - Publish every pcb slot as stopped
+ *  kinfo_publish_pcb() - Copy the state of a pcb into its row
+ *  kinfo_switch() - Publish the pcb about to run and the clock
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+
+static kernel_info_t kinfo_page __attribute__((aligned(NBPG)));
+
+const volatile kernel_info_t *kernel_info = &kinfo_page;
+
+/**
+ * Publish every pcb slot as stopped
+ */
+void kinfo_init(void) {
+    memset(&kinfo_page, 0, sizeof(kinfo_page));
+    for(int i = 0; i < PCB_TABLE_SIZE; i++) {
+        kinfo_page.procs[i].status = PROC_STATE_STOPPED;
+    }
+}
+
+/**
+ * Copy the state of the pcb into its row, the idle row for the idle process
+ */
+void kinfo_publish_pcb(pcb_t *pcb) {
+    kernel_info_proc_t *row = pcb->pid == 0
+        ? &kinfo_page.idle
+        : &kinfo_page.procs[(pcb->pid - 1) % PCB_TABLE_SIZE];
+
+    row->pid = pcb->pid;
+    row->status = pcb->state + pcb->blocked_status;
+    row->cpu_time = pcb->cpu_time;
+    row->priority = pcb->priority;
+    row->rt_misses = pcb->rt_misses;
+    row->involuntary_switches = pcb->involuntary_switches;
+}
+
+/**
+ * Publish the pcb about to run and the clock, and start a new generation
+ */
+void kinfo_switch(pcb_t *pcb) {
+    kinfo_publish_pcb(pcb);
+    kinfo_page.current_pid = pcb->pid;
+    kinfo_page.clock_ticks = get_clock_ticks();
+    kinfo_page.generation++;
+}
@@ -1,9 +1,30 @@
 /* mem.c : memory manager 
+ *
+ * Every chunk starts with a header holding its size. A free chunk also ends
+ * with a footer repeating its size, and the chunk after it has
+ * CHUNK_PREV_FREE set, so kfree() finds and merges both physical neighbours
+ * in constant time. A chunk is in use when its sanity check cookie points at
+ * its data. Each region ends in a fence chunk that is never free.
+ *
+ * Free chunks of up to SMALL_CHUNK_MAX bytes sit on exact size bins, larger
+ * ones in power of two buckets, both with bitmaps of the non-empty lists.
+ * Allocation takes the first chunk of the smallest small bin that fits, or
+ * the best fit in the bucket of the requested size, or the first chunk of
+ * the next non-empty bucket, and splits off the rest.
+ *
+ * Underneath, the usable memory outside the hole belongs to a binary buddy
+ * allocator handing out blocks of 2^order pages aligned to their size. The
+ * state of every page is kept in page_info, so a freed block finds whether
+ * its buddy is free in constant time. The heap grows by taking blocks from
+ * it as regions, and gives a region back once all of it is free again.
  *
  * Called from outside:
  *  kmeminit() - Initialize the memory manager
  *  kmalloc()  - Allocate a chunk of memory. Returns a pointer to starting location
  *  kfree()    - Free memory block starting at provided pointer if it passes sanity check
+ *  kpage_alloc() - Allocate a block of 2^order pages aligned to its size
+ *  kpage_free() - Free a block of pages from kpage_alloc()
+ *  kpage_order() - Smallest order of a page block holding the given size
  *  mem_dump_to_stdout() - Print out the free mem list to the screen 
  *  verify_sysptr() - Checks if pointer passed in syscall is valid
  */
@@ -13,8 +34,10 @@
 
 extern long freemem;    /* start of free memory (set in i386.c) */
 extern char *maxaddr;   /* max memory address (set in i386.c)  */
+extern mem_range_t ram_ranges[]; /* usable memory (set in i386.c) */
+extern int num_ram_ranges;
 
-/* memory header is a node for the free list */
+/* memory header, links a free chunk into its bin */
 typedef struct mem_header {
    unsigned long size;
    struct mem_header *prev;
@@ -23,31 +46,167 @@ typedef struct mem_header {
    unsigned char data_start[];
 } mem_header_t;
 
-/* free list is a list of free chunks in memory */
-static mem_header_t *free_list;
+#define CHUNK_PREV_FREE 0x1       /* Flag in size: the chunk before this one is free */
+#define CHUNK_SIZE(chunk) ((chunk)->size & ~(PARAGRAPH_SIZE - 1))
+#define CHUNK_IN_USE(chunk) ((chunk)->sanity_check == (char *)(chunk)->data_start)
+#define CHUNK_FOOTER(chunk, size) ((unsigned long *)((size_t)(chunk) + (size)) - 1)
+
+#define MIN_CHUNK (sizeof(mem_header_t) + PARAGRAPH_SIZE) /* Smallest block worth splitting off */
+#define SMALL_CHUNK_MAX 496       /* Largest chunk kept on an exact size bin */
+#define NUM_SMALL_BINS (SMALL_CHUNK_MAX / PARAGRAPH_SIZE + 1)
+#define NUM_BUCKETS 32            /* Bucket n holds chunks of 2^n up to 2^(n+1) bytes */
+#define NUM_HEAP_REGIONS 64       /* Page blocks the heap can grow into */
+#define HEAP_GROW_SIZE (16 * NBPG) /* Smallest block the heap grows by */
+
+#define PAGE_ORDERS 16            /* Page blocks go from 1 up to 2^15 pages */
+#define PAGE_FREE 0x80            /* page_info: first page of a free block, with its order */
+#define PAGE_USED 0x40            /* page_info: first page of an allocated block, with its order */
+#define PAGE_ORDER_MASK 0x3f
+#define PAGE_INDEX(addr) ((size_t)(addr) / NBPG)
+
+/* A free block of pages, linked into the list for its order */
+typedef struct page_block {
+    struct page_block *prev;
+    struct page_block *next;
+} page_block_t;
+
+/* Free small chunks by size in paragraphs, bit n of the bitmap is set when
+ * small_bins[n] is non-empty */
+static mem_header_t *small_bins[NUM_SMALL_BINS];
+static unsigned long small_bitmap;
+
+/* Free larger chunks by size, bit n of the bitmap is set when buckets[n] is
+ * non-empty */
+static mem_header_t *buckets[NUM_BUCKETS];
+static unsigned long bucket_bitmap;
+
+/* First chunk and fence of each heap region */
+static mem_header_t *region_start[NUM_HEAP_REGIONS];
+static mem_header_t *region_fence[NUM_HEAP_REGIONS];
+static int num_regions;
+
+/* Free page blocks by order, bit n of the bitmap is set when free_pages[n]
+ * is non-empty */
+static page_block_t *free_pages[PAGE_ORDERS];
+static unsigned long page_bitmap;
+
+/* One PAGE_FREE or PAGE_USED entry for the first page of every block, 0 for
+ * any other page */
+static unsigned char *page_info;
+static size_t num_pages;
 
 static size_t align_to_paragraph(size_t address);
-static void coalesce_blocks(mem_header_t *first, mem_header_t *second);
+static bool grow_heap(size_t required_chunk);
+static void init_region(size_t start, size_t end);
+static void release_region(mem_header_t *chunk, mem_header_t *fence);
+static mem_header_t *take_free_chunk(size_t required_chunk);
+static void split_chunk(mem_header_t *chunk, size_t required_chunk);
+static void make_free(mem_header_t *chunk, unsigned long size);
+static void bin_insert(mem_header_t *chunk);
+static void bin_remove(mem_header_t *chunk);
+static mem_header_t **bin_of(unsigned long size, unsigned long **bitmap, int *bit);
+static int highest_bit(unsigned long value);
+static int lowest_bit(unsigned long value);
+static void add_pages(size_t start, size_t end);
+static void page_insert(page_block_t *block, int order);
+static void page_remove(page_block_t *block, int order);
 
 /**
- * Initialize free memory list
+ * Give the usable memory past the kernel and outside the hole to the page
+ * allocator. The heap starts empty and grows on the first kmalloc().
  */
 void kmeminit(void) {
-    size_t memstart = align_to_paragraph(freemem);
-    free_list = (mem_header_t *) memstart;
-    free_list->size = (size_t)(HOLESTART - memstart);
-    free_list->sanity_check = NULL;
-    free_list->prev = NULL;
-   
-    /* Second node in free mem list after the hole */ 
-    mem_header_t *second_region = (mem_header_t *) HOLEEND;
-    second_region->size = (size_t)(maxaddr - HOLEEND) & ~(PARAGRAPH_SIZE - 1);
-    second_region->prev = free_list;
-    second_region->sanity_check = NULL;
-    second_region->next = NULL;
+    for(int i = 0; i < NUM_SMALL_BINS; i++) {
+        small_bins[i] = NULL;
+    }
+    for(int i = 0; i < NUM_BUCKETS; i++) {
+        buckets[i] = NULL;
+    }
+    small_bitmap = 0;
+    bucket_bitmap = 0;
+    num_regions = 0;
+
+    for(int i = 0; i < PAGE_ORDERS; i++) {
+        free_pages[i] = NULL;
+    }
+    page_bitmap = 0;
+
+    // The page states take the first bytes of free memory
+    num_pages = PAGE_INDEX((size_t)maxaddr + 1);
+    page_info = (unsigned char *)freemem;
+    for(size_t i = 0; i < num_pages; i++) {
+        page_info[i] = 0;
+    }
+
+    size_t first_free = ((size_t)freemem + num_pages + NBPG - 1) & ~(NBPG - 1);
+    for(int i = 0; i < num_ram_ranges; i++) {
+        size_t start = ram_ranges[i].start > first_free ? ram_ranges[i].start : first_free;
+        size_t end = ram_ranges[i].end;
 
-    free_list->next = second_region;
-    return;
+        // The hole holds the bios, video memory and the boot loader
+        if(start < HOLESTART) {
+            add_pages(start, end < HOLESTART ? end : HOLESTART);
+        }
+        if(end > HOLEEND) {
+            add_pages(start > HOLEEND ? start : HOLEEND, end);
+        }
+    }
+}
+
+/**
+ * Add a page block big enough for a chunk of the required size to the heap.
+ * Returns false if the heap has no room for another region or no block is
+ * free.
+ */
+static bool grow_heap(size_t required_chunk) {
+    if(num_regions == NUM_HEAP_REGIONS) {
+        return FALSE;
+    }
+
+    size_t size = required_chunk + sizeof(mem_header_t);
+    int order = kpage_order(size < HEAP_GROW_SIZE ? HEAP_GROW_SIZE : size);
+    void *block = kpage_alloc(order);
+    if(block == NULL) {
+        return FALSE;
+    }
+
+    init_region((size_t)block, (size_t)block + (NBPG << order));
+    return TRUE;
+}
+
+/**
+ * Make the memory from start to end a heap region of one free chunk followed
+ * by a fence. The fence points back at the start of the region.
+ */
+static void init_region(size_t start, size_t end) {
+    mem_header_t *fence = (mem_header_t *)(end - sizeof(mem_header_t));
+    fence->size = sizeof(mem_header_t);
+    fence->prev = (mem_header_t *)start;
+    fence->sanity_check = (char *)fence->data_start;
+
+    mem_header_t *chunk = (mem_header_t *)start;
+    chunk->size = 0;
+    make_free(chunk, (size_t)fence - start);
+
+    region_start[num_regions] = chunk;
+    region_fence[num_regions] = fence;
+    num_regions++;
+}
+
+/**
+ * Give a heap region whose memory is one free chunk, not on any bin, back to
+ * the page allocator
+ */
+static void release_region(mem_header_t *chunk, mem_header_t *fence) {
+    for(int i = 0; i < num_regions; i++) {
+        if(region_fence[i] == fence) {
+            num_regions--;
+            region_start[i] = region_start[num_regions];
+            region_fence[i] = region_fence[num_regions];
+            break;
+        }
+    }
+    kpage_free(chunk);
 }
 
 /**
@@ -60,43 +219,24 @@ void *kmalloc(size_t size) {
     }
 
     size_t required_chunk = align_to_paragraph(size) + sizeof(mem_header_t);
-    mem_header_t *curr = free_list;
-
-    while(curr != NULL) {
-        if(required_chunk <= curr->size) {
-            if(required_chunk != curr->size) {
-                mem_header_t *leftover = (mem_header_t *)((size_t)curr + required_chunk);
-                leftover->size = curr->size - required_chunk;
-                leftover->prev = curr;
-                leftover->next = curr->next;
-                if(curr->next != NULL) {
-                    curr->next->prev = leftover;
-                }
-
-                curr->next = leftover;
-            }
-
-            if(curr->prev) {
-                curr->prev->next = curr->next;
-            } else {
-                free_list = curr->next;
-            }
-
-            curr->size = required_chunk;
-            curr->next->prev = curr->prev;
-            curr->sanity_check = (void*) curr->data_start;
-            return curr->data_start;
-        }
-
-        curr = curr->next;
+    mem_header_t *chunk = take_free_chunk(required_chunk);
+    if(chunk == NULL && grow_heap(required_chunk)) {
+        chunk = take_free_chunk(required_chunk);
+    }
+    if(chunk == NULL) {
+        LOG("kmalloc unable to allocate requested memory: %d \n", size);
+        return 0;
     }
 
-    LOG("kmalloc unable to allocate requested memory: %d \n", size);
-    return 0;
+    split_chunk(chunk, required_chunk);
+    chunk->sanity_check = (void*) chunk->data_start;
+    return chunk->data_start;
 }
 
 /**
  * kfree frees the dynamically allocated memory and returns it to the free list
+ * merging it with free neighbours. A region left entirely free goes back to
+ * the page allocator, unless it is the last one.
  * returns 1 if success, else 0
  * */
 int kfree(void *ptr) {
@@ -104,71 +244,356 @@ int kfree(void *ptr) {
     if(node->sanity_check != ptr) {
         return 0;
     }
+    // Clear it before a merge moves node to the previous chunk, so freeing ptr again fails
+    node->sanity_check = NULL;
+
+    unsigned long size = CHUNK_SIZE(node);
+    mem_header_t *next = (mem_header_t *)((size_t)node + size);
+    if(!CHUNK_IN_USE(next)) {
+        bin_remove(next);
+        size += CHUNK_SIZE(next);
+    }
 
-    mem_header_t *prev = NULL;
-    mem_header_t *next = free_list;
-    while(next != NULL && next < node) {
-        prev = next;
-        next = next->next;
+    if(node->size & CHUNK_PREV_FREE) {
+        unsigned long prev_size = *((unsigned long *)node - 1);
+        node = (mem_header_t *)((size_t)node - prev_size);
+        bin_remove(node);
+        size += prev_size;
     }
 
-    if(prev != NULL) {
-        prev->next = node;
-    } else {
-        free_list = node;
+    // Only a fence is as small as a header
+    mem_header_t *fence = (mem_header_t *)((size_t)node + size);
+    if(CHUNK_SIZE(fence) == sizeof(mem_header_t) && fence->prev == node && num_regions > 1) {
+        release_region(node, fence);
+        return 1;
+    }
+
+    make_free(node, size);
+    return 1;
+}
+
+/**
+ * Allocate a block of 2^order pages aligned to its size, splitting the
+ * smallest free block that is big enough.
+ * Returns the address of the block, or null if no block is big enough.
+ */
+void *kpage_alloc(int order) {
+    if(order < 0 || order >= PAGE_ORDERS) {
+        return NULL;
     }
 
-    if(next != NULL) {
-        next->prev = node;
+    unsigned long fitting = page_bitmap & ~((1UL << order) - 1);
+    if(fitting == 0) {
+        LOG("kpage_alloc unable to allocate order %d\n", order);
+        return NULL;
     }
 
-    node->prev = prev;
-    node->next = next;
-    coalesce_blocks(node, next);
-    coalesce_blocks(prev, node);
+    int block_order = lowest_bit(fitting);
+    page_block_t *block = free_pages[block_order];
+    page_remove(block, block_order);
+
+    // Give back the upper half until the block is the requested size
+    while(block_order > order) {
+        block_order--;
+        page_insert((page_block_t *)((size_t)block + (NBPG << block_order)), block_order);
+    }
+
+    page_info[PAGE_INDEX(block)] = PAGE_USED | order;
+    return block;
+}
+
+/**
+ * kpage_free returns a block from kpage_alloc() to the page allocator,
+ * merging it with its buddy for as long as the buddy is free.
+ * returns 1 if success, else 0
+ */
+int kpage_free(void *page) {
+    size_t addr = (size_t)page;
+    if((addr & (NBPG - 1)) || PAGE_INDEX(addr) >= num_pages
+            || !(page_info[PAGE_INDEX(addr)] & PAGE_USED)) {
+        return 0;
+    }
+
+    int order = page_info[PAGE_INDEX(addr)] & PAGE_ORDER_MASK;
+    page_info[PAGE_INDEX(addr)] = 0;
+
+    while(order + 1 < PAGE_ORDERS) {
+        size_t buddy = addr ^ (NBPG << order);
+        if(PAGE_INDEX(buddy) >= num_pages || page_info[PAGE_INDEX(buddy)] != (PAGE_FREE | order)) {
+            break;
+        }
+        page_remove((page_block_t *)buddy, order);
+        addr &= ~(NBPG << order);
+        order++;
+    }
+
+    page_insert((page_block_t *)addr, order);
     return 1;
 }
 
 /**
- *  Aligns the given address to the 16 byte paragraph 
+ * The smallest order of a page block holding size bytes. Returns PAGE_ORDERS
+ * or more, which kpage_alloc() rejects, if no block is that big.
  */
-size_t align_to_paragraph(size_t address) {
-    if(address & (PARAGRAPH_SIZE - 1)) {
-        return (address + PARAGRAPH_SIZE) & ~(PARAGRAPH_SIZE - 1);
+int kpage_order(size_t size) {
+    int order = 0;
+    while(order < PAGE_ORDERS && ((size_t)NBPG << order) < size) {
+        order++;
     }
+    return order;
+}
 
-    return address;
+/**
+ * Hand the pages from start to end to the page allocator as the largest
+ * blocks that are aligned to their size and fit
+ */
+static void add_pages(size_t start, size_t end) {
+    while(start < end) {
+        int order = 0;
+        while(order + 1 < PAGE_ORDERS
+                && (start & ((NBPG << (order + 1)) - 1)) == 0
+                && start + (NBPG << (order + 1)) <= end) {
+            order++;
+        }
+        page_insert((page_block_t *)start, order);
+        start += NBPG << order;
+    }
 }
 
 /**
- * Combine two free mem blocks if they are next to each other.
+ * Put the free block at the head of the list for its order
  */
-void coalesce_blocks(mem_header_t *first, mem_header_t *second) {
-    if(first == NULL || second == NULL) {
-        return;
+static void page_insert(page_block_t *block, int order) {
+    block->prev = NULL;
+    block->next = free_pages[order];
+    if(block->next != NULL) {
+        block->next->prev = block;
     }
-    
-    if(first->data_start + first->size < second->data_start) {
+    free_pages[order] = block;
+    SET_BIT(page_bitmap, order);
+    page_info[PAGE_INDEX(block)] = PAGE_FREE | order;
+}
+
+/**
+ * Take the free block off the list for its order
+ */
+static void page_remove(page_block_t *block, int order) {
+    if(block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        free_pages[order] = block->next;
+    }
+    if(block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    if(free_pages[order] == NULL) {
+        CLEAR_BIT(page_bitmap, order);
+    }
+    page_info[PAGE_INDEX(block)] = 0;
+}
+
+/**
+ * Take the best free chunk for the required size out of its bin.
+ * Returns null if no chunk is big enough.
+ */
+static mem_header_t *take_free_chunk(size_t required_chunk) {
+    mem_header_t *best = NULL;
+
+    // Any chunk on a small bin at least as big fits
+    if(required_chunk <= SMALL_CHUNK_MAX) {
+        int bin = required_chunk / PARAGRAPH_SIZE;
+        unsigned long fitting = small_bitmap & ~((1UL << bin) - 1);
+        if(fitting != 0) {
+            best = small_bins[lowest_bit(fitting)];
+            bin_remove(best);
+            return best;
+        }
+    }
+
+    // Chunks in larger buckets all fit, only this one needs a search
+    int bucket = highest_bit(required_chunk);
+    mem_header_t *curr = buckets[bucket];
+    while(curr != NULL && (best == NULL || CHUNK_SIZE(best) != required_chunk)) {
+        if(CHUNK_SIZE(curr) >= required_chunk
+                && (best == NULL || CHUNK_SIZE(curr) < CHUNK_SIZE(best))) {
+            best = curr;
+        }
+        curr = curr->next;
+    }
+
+    if(best == NULL) {
+        unsigned long larger = bucket + 1 < NUM_BUCKETS
+            ? bucket_bitmap & ~((2UL << bucket) - 1) : 0;
+        if(larger == 0) {
+            return NULL;
+        }
+        best = buckets[lowest_bit(larger)];
+    }
+
+    bin_remove(best);
+    return best;
+}
+
+/**
+ * Mark a chunk taken off its bin in use, first freeing whatever is left over
+ * after required_chunk bytes if that is big enough to be used
+ */
+static void split_chunk(mem_header_t *chunk, size_t required_chunk) {
+    unsigned long size = CHUNK_SIZE(chunk);
+
+    if(size - required_chunk >= MIN_CHUNK) {
+        chunk->size = required_chunk | (chunk->size & CHUNK_PREV_FREE);
+        mem_header_t *leftover = (mem_header_t *)((size_t)chunk + required_chunk);
+        leftover->size = 0;
+        make_free(leftover, size - required_chunk);
         return;
     }
 
-    first->size = second->data_start + second->size - first->data_start;
-    first->next = second->next;
-    if(second->next != NULL) {
-        second->next->prev = first;
+    mem_header_t *next = (mem_header_t *)((size_t)chunk + size);
+    next->size &= ~CHUNK_PREV_FREE;
+}
+
+/**
+ * Turn the chunk into a free chunk of the given size and put it on its bin.
+ * The chunk before it must be in use.
+ */
+static void make_free(mem_header_t *chunk, unsigned long size) {
+    chunk->size = size;
+    chunk->sanity_check = NULL;
+    *CHUNK_FOOTER(chunk, size) = size;
+
+    mem_header_t *next = (mem_header_t *)((size_t)chunk + size);
+    next->size |= CHUNK_PREV_FREE;
+    bin_insert(chunk);
+}
+
+/**
+ * Put the free chunk at the head of the bin for its size
+ */
+static void bin_insert(mem_header_t *chunk) {
+    unsigned long *bitmap;
+    int bit;
+    mem_header_t **bin = bin_of(CHUNK_SIZE(chunk), &bitmap, &bit);
+
+    chunk->prev = NULL;
+    chunk->next = *bin;
+    if(*bin != NULL) {
+        (*bin)->prev = chunk;
     }
+    *bin = chunk;
+    SET_BIT(*bitmap, bit);
 }
 
 /**
- * Dumps information about the free list to console
+ * Take the free chunk off its bin
+ */
+static void bin_remove(mem_header_t *chunk) {
+    unsigned long *bitmap;
+    int bit;
+    mem_header_t **bin = bin_of(CHUNK_SIZE(chunk), &bitmap, &bit);
+
+    if(chunk->prev != NULL) {
+        chunk->prev->next = chunk->next;
+    } else {
+        *bin = chunk->next;
+    }
+    if(chunk->next != NULL) {
+        chunk->next->prev = chunk->prev;
+    }
+    if(*bin == NULL) {
+        CLEAR_BIT(*bitmap, bit);
+    }
+}
+
+/**
+ * The bin for free chunks of the given size, with the bitmap and bit that
+ * track whether it is empty
+ */
+static mem_header_t **bin_of(unsigned long size, unsigned long **bitmap, int *bit) {
+    if(size <= SMALL_CHUNK_MAX) {
+        *bitmap = &small_bitmap;
+        *bit = size / PARAGRAPH_SIZE;
+        return &small_bins[*bit];
+    }
+
+    *bitmap = &bucket_bitmap;
+    *bit = highest_bit(size);
+    return &buckets[*bit];
+}
+
+/**
+ * Index of the highest set bit of a non-zero value
+ */
+static int highest_bit(unsigned long value) {
+    int index;
+    __asm__ volatile( " \
+        bsrl %1, %0 \n"
+        : "=r" (index)
+        : "rm" (value)
+    );
+    return index;
+}
+
+/**
+ * Index of the lowest set bit of a non-zero value
+ */
+static int lowest_bit(unsigned long value) {
+    int index;
+    __asm__ volatile( " \
+        bsfl %1, %0 \n"
+        : "=r" (index)
+        : "rm" (value)
+    );
+    return index;
+}
+
+/**
+ *  Aligns the given address to the 16 byte paragraph 
+ */
+size_t align_to_paragraph(size_t address) {
+    if(address & (PARAGRAPH_SIZE - 1)) {
+        return (address + PARAGRAPH_SIZE) & ~(PARAGRAPH_SIZE - 1);
+    }
+
+    return address;
+}
+
+/**
+ * Dumps the free chunks of each heap region in address order, the occupied
+ * small bins, the free page blocks and the object caches to console
  */
 void mem_dump(void) {
-    mem_header_t *curr = free_list;
-    while(curr != NULL) {
-        kprintf("Start address: %ld Size: %ld\n", curr, curr->size);
-        curr = curr->next;
+    for(int i = 0; i < num_regions; i++) {
+        mem_header_t *curr = region_start[i];
+        while(curr != region_fence[i]) {
+            if(!CHUNK_IN_USE(curr)) {
+                kprintf("Start address: %ld Size: %ld\n", curr, CHUNK_SIZE(curr));
+            }
+            curr = (mem_header_t *)((size_t)curr + CHUNK_SIZE(curr));
+        }
+    }
+
+    for(int i = 0; i < NUM_SMALL_BINS; i++) {
+        int count = 0;
+        for(mem_header_t *curr = small_bins[i]; curr != NULL; curr = curr->next) {
+            count++;
+        }
+        if(count > 0) {
+            kprintf("Small bin %d bytes: %d chunks\n", i * PARAGRAPH_SIZE, count);
+        }
+    }
+
+    for(int i = 0; i < PAGE_ORDERS; i++) {
+        int count = 0;
+        for(page_block_t *curr = free_pages[i]; curr != NULL; curr = curr->next) {
+            count++;
+        }
+        if(count > 0) {
+            kprintf("Order %d pages: %d free blocks\n", i, count);
+        }
     }
 
+    kmem_cache_dump();
     kprintf("\n");
 }
 
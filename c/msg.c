@@ -1,92 +1,401 @@
 /* msg.c : messaging system
+ *
+ * Every process owns a FIFO of the processes blocked sending to it and a
+ * queue of the processes blocked receiving from it. Processes receiving from
+ * anyone wait on a single shared queue. A rendezvous therefore only ever
+ * looks at the head of one queue or at the partner pcb itself.
+ *
+ * A blocked process keeps the buffers of its pending send or recv in its pcb
+ * so the partner can complete the transfer. sendrecv() chains a send and a
+ * recv from the same process into one call: once the request is taken the
+ * caller goes straight to waiting for the reply without becoming ready.
+ *
+ * A process may also have a mailbox, a ring of message slots on the kernel
+ * heap. send_async() hands its message to a receiver that is already
+ * waiting, and otherwise copies it into the receiver's mailbox and returns
+ * without blocking. recv() takes from the mailbox before it looks at the
+ * blocked senders, so messages from one sender arrive in the order sent.
  *
  * Called from outside:
  * send() - send a message to the specified process
  * recv() - recieve a message from the specified process
+ * try_send() - send a message only if the receiver is waiting for it
+ * try_recv() - recieve a message only if a sender is waiting
+ * sendrecv() - send a request and wait for the reply in one call
+ * replywait() - reply to a client and receive the next request in one call
+ * send_async() - send a message without blocking, through the receiver's mailbox
+ * set_mailbox() - give a process a mailbox of the given depth, or take it away
+ * fill_mailboxStatus() - fills the mailboxStatuses struct with mailbox counters
  */
 
 #include <xeroskernel.h>
 #include <xeroslib.h>
-#include <stdarg.h>
 #include <pcb.h>
 
-/* 
- * Send a message to the specified process
+/* A message waiting in a mailbox */
+typedef struct mailbox_msg {
+    pid_t from;                  /* The sender */
+    int len;                     /* Length of the message */
+    char data[MAILBOX_MSG_MAX];  /* The message */
+} mailbox_msg_t;
+
+/* A ring of depth message slots, the count queued messages start at head */
+struct mailbox {
+    int depth;
+    int head;
+    int count;
+    int max_count;               /* Most messages ever queued at once */
+    long delivered;              /* Messages taken by a recv */
+    long rejected;               /* Sends refused because the ring was full */
+    long dropped;                /* Messages discarded when the ring was replaced */
+    mailbox_msg_t msgs[];
+};
+
+static bool receiving_from(pcb_t *receiver, pcb_t *sender);
+static bool sending_to(pcb_t *sender, pcb_t *receiver);
+static int deliver(pcb_t *sender, void *buffer, int buffer_len, pcb_t *receiver);
+static void block_send(pcb_t *pcb, pcb_t *dest_proc, void *buffer, int buffer_len, bool call);
+static void block_recv(pcb_t *pcb, pcb_t *from_proc, pid_t *from_pid, void *buffer, int buffer_len);
+static int copy_message(pcb_t *sender, void *send_buffer, int send_len,
+        pcb_t *receiver, void *recv_buffer, int recv_len, pid_t *from_pid);
+static int mailbox_take(pcb_t *pcb, pcb_t *from_proc, pid_t *from_pid, void *buffer, int buffer_len);
+
+/*
+ * Send a message to the specified process. If it is blocked receiving from
+ * this process or from anyone the message is delivered right away and the
+ * receiver becomes ready, otherwise the sender blocks on the receiver.
+ * Returns the number of bytes sent, or BLOCKERR if the sender blocked.
  */
 int send(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len) {
-    pcb_t *any_receiver = peek_any_receiver();
-    bool exists = dest_proc != NULL && remove_pcb_from_blocked_queue(dest_proc);
-    if(exists || any_receiver != NULL) {
-        if(exists == FALSE) {
-            dest_proc = any_receiver;
+    int len = try_send(curr_proc, dest_proc, buffer, buffer_len);
+    if(len != BLOCKERR) {
+        return len;
+    }
+
+    block_send(curr_proc, dest_proc, buffer, buffer_len, FALSE);
+    return BLOCKERR;
+}
+
+/*
+ * Recieve a message from the specified process, or from the first process
+ * blocked sending to us if from_proc is null. If there is no such sender the
+ * receiver blocks until one arrives. The sender's pid is stored in from_pid.
+ * Returns the number of bytes received, or BLOCKERR if the receiver blocked.
+ */
+int recv(pcb_t *from_proc, pcb_t *curr_proc, pid_t *from_pid, void *buffer, int buffer_len) {
+    int len = try_recv(from_proc, curr_proc, from_pid, buffer, buffer_len);
+    if(len != BLOCKERR) {
+        return len;
+    }
+
+    block_recv(curr_proc, from_proc, from_pid, buffer, buffer_len);
+    return BLOCKERR;
+}
+
+/*
+ * Send a message to the specified process if it is blocked receiving from
+ * this process or from anyone, making it ready. The sender never blocks.
+ * Returns the number of bytes sent, or BLOCKERR if the receiver was not
+ * waiting, in which case nothing changed.
+ */
+int try_send(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len) {
+    ASSERT(curr_proc != NULL && dest_proc != NULL);
+
+    if(!receiving_from(dest_proc, curr_proc)) {
+        return BLOCKERR;
+    }
+    return deliver(curr_proc, buffer, buffer_len, dest_proc);
+}
+
+/*
+ * Recieve a message from the specified process, or from the first process
+ * blocked sending to us if from_proc is null, if that process is blocked
+ * sending. Messages waiting in the mailbox come first. The receiver never
+ * blocks.
+ * Returns the number of bytes received, or BLOCKERR if there was no such
+ * sender, in which case nothing changed.
+ */
+int try_recv(pcb_t *from_proc, pcb_t *curr_proc, pid_t *from_pid, void *buffer, int buffer_len) {
+    ASSERT(curr_proc != NULL);
+
+    int queued_len = mailbox_take(curr_proc, from_proc, from_pid, buffer, buffer_len);
+    if(queued_len != BLOCKERR) {
+        return queued_len;
+    }
+
+    pcb_t *sender = from_proc != NULL ? from_proc : pcb_peek(curr_proc->senders);
+    if(sender == NULL || !sending_to(sender, curr_proc)) {
+        return BLOCKERR;
+    }
+
+    remove_pcb_from_blocked_queue(sender);
+    int len = copy_message(sender, sender->ipc_send_buf, sender->ipc_send_len,
+            curr_proc, buffer, buffer_len, from_pid);
+
+    if(sender->ipc_call) {
+        // The request of a sendrecv was taken, the sender now waits for our reply
+        block_recv(sender, curr_proc, NULL, sender->ipc_recv_buf, sender->ipc_recv_len);
+    } else {
+        add_pcb_to_ready_queue(sender);
+    }
+    return len;
+}
+
+/*
+ * Send a message to the specified process without blocking. A receiver
+ * already waiting takes it at once, otherwise it is copied into the
+ * receiver's mailbox. The message must fit in a mailbox slot.
+ * Returns the number of bytes sent, SYSMAILBOX_NONE if the receiver has no
+ * mailbox, or BLOCKERR if its mailbox is full.
+ */
+int send_async(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len) {
+    ASSERT(buffer_len <= MAILBOX_MSG_MAX);
+
+    int len = try_send(curr_proc, dest_proc, buffer, buffer_len);
+    if(len != BLOCKERR) {
+        return len;
+    }
+
+    mailbox_t *box = dest_proc->mailbox;
+    if(box == NULL) {
+        return SYSMAILBOX_NONE;
+    }
+    if(box->count == box->depth) {
+        box->rejected++;
+        return BLOCKERR;
+    }
+
+    mailbox_msg_t *msg = &box->msgs[(box->head + box->count) % box->depth];
+    msg->from = curr_proc->pid;
+    msg->len = buffer_len;
+    blkcopy(msg->data, buffer, buffer_len);
+    box->count++;
+    if(box->count > box->max_count) {
+        box->max_count = box->count;
+    }
+    return buffer_len;
+}
+
+/*
+ * Give the pcb a mailbox of depth slots, or take it away if depth is 0.
+ * Messages already queued move to the new mailbox, oldest first, and those
+ * that don't fit are dropped. The counters carry over.
+ * Returns 0 on success, SYSMAILBOX_INVALID for a bad depth, or
+ * SYSMAILBOX_NO_MEMORY if the heap is exhausted.
+ */
+int set_mailbox(pcb_t *pcb, int depth) {
+    if(depth < 0 || depth > MAILBOX_MAX_DEPTH) {
+        return SYSMAILBOX_INVALID;
+    }
+
+    mailbox_t *box = NULL;
+    if(depth > 0) {
+        box = kmalloc(sizeof(mailbox_t) + depth * sizeof(mailbox_msg_t));
+        if(box == NULL) {
+            return SYSMAILBOX_NO_MEMORY;
         }
+        memset(box, 0, sizeof(mailbox_t));
+        box->depth = depth;
+    }
 
-        if(dest_proc->pid != 0 && dest_proc->blocked_id != curr_proc->pid) {
-            add_pcb_to_blocked_queue(dest_proc);
-            curr_proc->blocked_status = BLOCKED_STATUS_SEND;
-            curr_proc->blocked_id = dest_proc->pid;
-            add_pcb_to_blocked_queue(curr_proc);
-            return BLOCKERR;
+    mailbox_t *old = pcb->mailbox;
+    if(old != NULL) {
+        if(box != NULL) {
+            while(old->count > 0 && box->count < depth) {
+                blkcopy(&box->msgs[box->count++], &old->msgs[old->head], sizeof(mailbox_msg_t));
+                old->head = (old->head + 1) % old->depth;
+                old->count--;
+            }
+            box->max_count = old->max_count;
+            box->delivered = old->delivered;
+            box->rejected = old->rejected;
+            box->dropped = old->dropped + old->count;
+        }
+        kfree(old);
+    }
+
+    pcb->mailbox = box;
+    return 0;
+}
+
+/*
+ * Fills the mailboxStatuses struct with the counters of the pcb's mailbox.
+ * Returns 0, or SYSMAILBOX_NONE if the pcb has no mailbox.
+ */
+int fill_mailboxStatus(pcb_t *pcb, mailboxStatuses *ms) {
+    mailbox_t *box = pcb->mailbox;
+    if(box == NULL) {
+        return SYSMAILBOX_NONE;
+    }
+
+    ms->depth = box->depth;
+    ms->queued = box->count;
+    ms->maxQueued = box->max_count;
+    ms->delivered = box->delivered;
+    ms->rejected = box->rejected;
+    ms->dropped = box->dropped;
+    return 0;
+}
+
+/*
+ * Send a request to the specified process and wait for its reply. The caller
+ * always blocks, its return value is set to the length of the reply.
+ */
+void sendrecv(pcb_t *curr_proc, pcb_t *dest_proc, void *send_buffer, int send_len,
+        void *recv_buffer, int recv_len) {
+    ASSERT(curr_proc != NULL && dest_proc != NULL);
+
+    if(receiving_from(dest_proc, curr_proc)) {
+        deliver(curr_proc, send_buffer, send_len, dest_proc);
+        block_recv(curr_proc, dest_proc, NULL, recv_buffer, recv_len);
+        return;
+    }
+
+    curr_proc->ipc_recv_buf = recv_buffer;
+    curr_proc->ipc_recv_len = recv_len;
+    block_send(curr_proc, dest_proc, send_buffer, send_len, TRUE);
+}
+
+/*
+ * Reply to a client blocked waiting on the caller, if client_proc is not
+ * null, then receive the next message from anyone. The reply never blocks.
+ * Returns the number of bytes received, BLOCKERR if the caller blocked, or
+ * SYSERR_OTHER if the client was not waiting for a reply.
+ */
+int replywait(pcb_t *curr_proc, pcb_t *client_proc, void *reply, int reply_len,
+        pid_t *from_pid, void *buffer, int buffer_len) {
+    ASSERT(curr_proc != NULL);
+
+    if(client_proc != NULL) {
+        if(!receiving_from(client_proc, curr_proc)) {
+            return SYSERR_OTHER;
         }
+        deliver(curr_proc, reply, reply_len, client_proc);
+    }
+
+    return recv(NULL, curr_proc, from_pid, buffer, buffer_len);
+}
+
+/*
+ * Whether the receiver is blocked in recv and accepts a message from sender
+ */
+static bool receiving_from(pcb_t *receiver, pcb_t *sender) {
+    return receiver->state == PROC_STATE_BLOCKED
+        && receiver->blocked_status == BLOCKED_STATUS_RECEIVE
+        && (receiver->blocked_id == 0 || receiver->blocked_id == sender->pid);
+}
+
+/*
+ * Whether the sender is blocked sending to receiver
+ */
+static bool sending_to(pcb_t *sender, pcb_t *receiver) {
+    return sender->state == PROC_STATE_BLOCKED
+        && sender->blocked_status == BLOCKED_STATUS_SEND
+        && sender->blocked_id == receiver->pid;
+}
+
+/*
+ * Complete the pending recv of the receiver with the sender's message and
+ * make the receiver ready.
+ * Returns the number of bytes copied.
+ */
+static int deliver(pcb_t *sender, void *buffer, int buffer_len, pcb_t *receiver) {
+    remove_pcb_from_blocked_queue(receiver);
+    int len = copy_message(sender, buffer, buffer_len, receiver,
+            receiver->ipc_recv_buf, receiver->ipc_recv_len, receiver->ipc_from_pid);
+    add_pcb_to_ready_queue(receiver);
+    sender->ipc_partner = receiver->pid;
+    return len;
+}
 
-        va_list args = (va_list)dest_proc->args;
-        va_arg(args, int);
-        void *dest_buffer = (void*)(va_arg(args, int));
-        int dest_buffer_len = va_arg(args, int);
-
-        int min_buffer_len = buffer_len > dest_buffer_len ? dest_buffer_len : buffer_len;
-        blkcopy(dest_buffer, buffer, min_buffer_len);
-        add_pcb_to_ready_queue(dest_proc);
-        dest_proc->blocked_id = 0;
-        dest_proc->ret = min_buffer_len;
-        return min_buffer_len; 
+/*
+ * Block the pcb sending to dest_proc. If call is set the pcb waits for a
+ * reply once the message is taken.
+ */
+static void block_send(pcb_t *pcb, pcb_t *dest_proc, void *buffer, int buffer_len, bool call) {
+    pcb->blocked_status = BLOCKED_STATUS_SEND;
+    pcb->blocked_id = dest_proc->pid;
+    pcb->ipc_send_buf = buffer;
+    pcb->ipc_send_len = buffer_len;
+    pcb->ipc_call = call;
+    add_pcb_to_blocked_queue(pcb, dest_proc->senders);
+}
+
+/*
+ * Block the pcb receiving from from_proc, or from anyone if it is null
+ */
+static void block_recv(pcb_t *pcb, pcb_t *from_proc, pid_t *from_pid, void *buffer, int buffer_len) {
+    pcb->blocked_status = BLOCKED_STATUS_RECEIVE;
+    pcb->ipc_from_pid = from_pid;
+    pcb->ipc_recv_buf = buffer;
+    pcb->ipc_recv_len = buffer_len;
+    if(from_proc != NULL) {
+        pcb->blocked_id = from_proc->pid;
+        add_pcb_to_blocked_queue(pcb, from_proc->receivers);
     } else {
-        curr_proc->blocked_status = BLOCKED_STATUS_SEND;
-        curr_proc->blocked_id = dest_proc->pid;
-        add_pcb_to_blocked_queue(curr_proc);
-        return BLOCKERR;
+        pcb->blocked_id = 0;
+        add_pcb_to_any_receivers(pcb);
     }
 }
 
 /*
- * Recieve a message from the specified process
+ * Copy the message between the buffers, set the return value of both sides
+ * and tell the receiver who sent it if from_pid is not null.
+ * Returns the number of bytes copied.
  */
-int recv(pcb_t *from_proc, pcb_t *curr_proc, void *buffer, int buffer_len) {
-    bool exists = from_proc != NULL;
-    if(!exists) {
-       from_proc = peek_next_sender();
+static int copy_message(pcb_t *sender, void *send_buffer, int send_len,
+        pcb_t *receiver, void *recv_buffer, int recv_len, pid_t *from_pid) {
+    int min_buffer_len = send_len > recv_len ? recv_len : send_len;
+    blkcopy(recv_buffer, send_buffer, min_buffer_len);
+    region_transfer(sender, send_buffer, min_buffer_len, receiver);
+
+    if(from_pid != NULL) {
+        *from_pid = sender->pid;
     }
 
-    if(from_proc != NULL && remove_pcb_from_blocked_queue(from_proc)) {
-        va_list args = (va_list)from_proc->args;
-        va_arg(args, int);
-        void *from_buffer = (void*)(va_arg(args, int));
-        int from_buffer_len = va_arg(args, int);
+    sender->blocked_id = 0;
+    receiver->blocked_id = 0;
+    sender->ret = min_buffer_len;
+    receiver->ret = min_buffer_len;
+    return min_buffer_len;
+}
+
+/*
+ * Take the oldest message from from_proc, or from anyone if it is null, out
+ * of the pcb's mailbox and copy it to the buffer. Later messages move up to
+ * close the gap.
+ * Returns the number of bytes copied, or BLOCKERR if there is no such message.
+ */
+static int mailbox_take(pcb_t *pcb, pcb_t *from_proc, pid_t *from_pid, void *buffer, int buffer_len) {
+    mailbox_t *box = pcb->mailbox;
+    if(box == NULL || box->count == 0) {
+        return BLOCKERR;
+    }
 
-        if(exists && from_proc->blocked_id != curr_proc->pid) {
-            add_pcb_to_blocked_queue(from_proc);
-            curr_proc->blocked_status = BLOCKED_STATUS_RECEIVE;
-            curr_proc->blocked_id = from_proc->pid;
-            add_pcb_to_blocked_queue(curr_proc);
+    int i = 0;
+    while(from_proc != NULL && box->msgs[(box->head + i) % box->depth].from != from_proc->pid) {
+        if(++i == box->count) {
             return BLOCKERR;
         }
-       
-        int min_buffer_len = buffer_len > from_buffer_len ? from_buffer_len : buffer_len;
-        blkcopy(buffer, from_buffer, min_buffer_len);
-        add_pcb_to_ready_queue(from_proc);
-        from_proc->blocked_id = 0;
-        from_proc->ret = min_buffer_len;
-        return min_buffer_len;
+    }
+
+    mailbox_msg_t *msg = &box->msgs[(box->head + i) % box->depth];
+    int len = msg->len > buffer_len ? buffer_len : msg->len;
+    blkcopy(buffer, msg->data, len);
+    if(from_pid != NULL) {
+        *from_pid = msg->from;
+    }
+
+    if(i == 0) {
+        box->head = (box->head + 1) % box->depth;
     } else {
-        curr_proc->blocked_status = BLOCKED_STATUS_RECEIVE;
-        if(exists) {
-            curr_proc->blocked_id = from_proc->pid;
-        } else {
-            curr_proc->blocked_id = 0;
+        for(; i < box->count - 1; i++) {
+            blkcopy(&box->msgs[(box->head + i) % box->depth],
+                    &box->msgs[(box->head + i + 1) % box->depth], sizeof(mailbox_msg_t));
         }
-        add_pcb_to_blocked_queue(curr_proc);
-        return BLOCKERR;
     }
+    box->count--;
+    box->delivered++;
+    pcb->ret = len;
+    return len;
 }
-
-
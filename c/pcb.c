@@ -3,20 +3,25 @@
  * Called from outside:
  *  initpcb() - Intialize the PCB table and all process queues
  *  add_pcb_to_stopped_queue() - Adds the pcb to the stopped queue
- *  add_pcb_to_ready_queue() - Adds the pcb to the ready queue
- *  remove_pcb_from_ready_queue() - Removes the pcb from the ready queue
- *  add_pcb_to_blocked_queue() - Adds the pcb to the blocked queue
- *  remove_pcb_from_blocked_queue() - Removes the pcb from the blocked queue
- *  peek_next_sender() - Peeks the next sender pcb
- *  peek_any_receiver() - Peeks the next any receiver pcb
- *  unblock_pcb_waiting_for_pid() - Unblock the pcbs waiting for the given pid from the blocked queue and adds it to the ready queue
- *  get_next_pcb() - Get the next PCB from the process queue
+ *  add_pcb_to_ready_queue() - Adds the pcb to the ready queue of its priority level
+ *  remove_pcb_from_ready_queue() - Removes the pcb from the ready queue of its priority level
+ *  add_pcb_to_blocked_queue() - Adds the pcb to the queue of a process it is blocked on
+ *  add_pcb_to_any_receivers() - Adds the pcb to the queue of processes receiving from anyone
+ *  remove_pcb_from_blocked_queue() - Removes the pcb from whichever blocked queue it is on
+ *  unblock_pcbs_blocked_on() - Unblock every pcb sending to, receiving from or waiting on the given pcb
+ *  get_next_pcb() - Get the next PCB from the highest priority non-empty ready queue
+ *  take_pcb_if_next() - Take a ready pcb to run if get_next_pcb() could have picked it
+ *  ready_queue_empty() - Whether no process is ready to run
+ *  ready_pcb_preempts() - Whether a ready pcb should run before the running pcb's quantum ends
+ *  set_pcb_priority() - Change the priority of a pcb, moving it between ready queues if needed
+ *  reset_pcb_priorities() - Return every active pcb to its base priority
+ *  release_rt_pcbs() - Start the next job of every real-time pcb whose period has elapsed
  *  get_free_pcb() - Return an available PCB to use for a new process from PCB table
  *  pid_to_pcb() -  Returns the pcb associated with the given pid if it's valid 
  *  cleanup_pcb() - Free memory allocated to this pcb
  *  dump_stopped_queue() - Print stopped queue to console
  *  dump_ready_queue() - Print process queue to console
- *  dump_blocked_queue() - Print blocked queue to console
+ *  dump_blocked_queues() - Print the queues of processes blocked on a pcb to console
  *  fill_processStatus() - Fills processStatus struct with various pcb info
  */
 
@@ -24,26 +29,66 @@
 #include <pcb.h>
 
 static pcb_queue_t *stopped_queue;
-static pcb_queue_t *ready_queue;
-static pcb_queue_t *blocked_queue;
+static pcb_queue_t *ready_queues[PRIORITY_LEVELS];
+static pcb_queue_t *any_receivers;
 static pcb_t pcb_array[PCB_TABLE_SIZE];
 
+/* Real-time pcbs are scheduled ahead of all others, earliest deadline first */
+static pcb_queue_t *rt_ready_queue;
+static pcb_queue_t *rt_wait_queue;
+
+/* Bit n is set when ready_queues[n] is non-empty */
+static unsigned long ready_bitmap;
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+/* Under the stride policy the ready set is a min-heap ordered by pass */
+static pcb_heap_t *ready_heap;
+static unsigned long global_pass;
+#endif
+
+#if SCHED_POLICY != SCHED_POLICY_STRIDE
+static int find_first_set(unsigned long bitmap);
+#endif
+static bool deadline_before(pcb_t *a, pcb_t *b);
+static bool rt_job_unfinished(pcb_t *pcb);
+static void enqueue_ready_pcb(pcb_t *pcb);
+
 /**
  * Initalizes the pcb array and the process queues used by the dispatcher
  */
 void initpcb(void) {
     stopped_queue = (pcb_queue_t *) init_pcb_queue();
-    ready_queue = (pcb_queue_t *) init_pcb_queue();
-    blocked_queue = (pcb_queue_t *) init_pcb_queue();
+    for(int i = 0; i < PRIORITY_LEVELS; i++) {
+        ready_queues[i] = (pcb_queue_t *) init_pcb_queue();
+    }
+    ready_bitmap = 0;
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    ready_heap = init_pcb_heap();
+    global_pass = 0;
+#endif
+    any_receivers = (pcb_queue_t *) init_pcb_queue();
+    rt_ready_queue = (pcb_queue_t *) init_pcb_queue();
+    rt_wait_queue = (pcb_queue_t *) init_pcb_queue();
     for(int i = 0; i < PCB_TABLE_SIZE; i++) {
         pcb_array[i].pid = i+1;
         pcb_array[i].blocked_id = 0;
         pcb_array[i].cpu_time = 0;
+        pcb_array[i].priority = PRIORITY_DEFAULT;
+        pcb_array[i].base_priority = PRIORITY_DEFAULT;
+        pcb_array[i].heap_index = -1;
+        pcb_array[i].involuntary_switches = 0;
+        pcb_array[i].senders = (pcb_queue_t *) init_pcb_queue();
+        pcb_array[i].receivers = (pcb_queue_t *) init_pcb_queue();
+        pcb_array[i].waiters = (pcb_queue_t *) init_pcb_queue();
+        pcb_array[i].ipc_partner = 0;
+        pcb_array[i].timer_slot = NULL;
+        pcb_array[i].mailbox = NULL;
         pcb_array[i].blocked_status = BLOCKED_STATUS_NONE;
         pcb_array[i].state = PROC_STATE_STOPPED;
         pcb_offer(stopped_queue, &pcb_array[i]);
     }
     
+    kinfo_init();
     sleepinit();
 }
 
@@ -55,101 +100,343 @@ void add_pcb_to_stopped_queue(pcb_t *pcb) {
     pcb->cpu_time = 0;
     pcb->state = PROC_STATE_STOPPED;
     pcb_offer(stopped_queue, pcb);
+    kinfo_publish_pcb(pcb);
 }
 
 /**
- * Adds the pcb to the ready queue
+ * Adds the pcb to the ready queue of its priority level. A real-time pcb goes
+ * to the deadline ordered real-time queue instead, or waits for its next
+ * release if its current job has no budget left.
  */
 void add_pcb_to_ready_queue(pcb_t *pcb) {
     ASSERT(pcb != NULL);
+    enqueue_ready_pcb(pcb);
+    kinfo_publish_pcb(pcb);
+}
+
+/**
+ * Queue the pcb for add_pcb_to_ready_queue() according to its class
+ */
+static void enqueue_ready_pcb(pcb_t *pcb) {
+    if(pcb->rt_period != 0) {
+        if(pcb->rt_budget_left == 0) {
+            pcb->state = PROC_STATE_BLOCKED;
+            pcb->blocked_status = BLOCKED_STATUS_PERIOD;
+            pcb_offer(rt_wait_queue, pcb);
+            return;
+        }
+
+        pcb->state = PROC_STATE_READY;
+        pcb->blocked_status = BLOCKED_STATUS_NONE;
+        pcb_insert_sorted(rt_ready_queue, pcb, &deadline_before);
+        return;
+    }
+
     pcb->state = PROC_STATE_READY;
     pcb->blocked_status = BLOCKED_STATUS_NONE;
-    pcb_offer(ready_queue, pcb);
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    // A process rejoining after blocking must not bank the pass it missed
+    if((long)(pcb->pass - global_pass) < 0) {
+        pcb->pass = global_pass;
+    }
+    pcb_heap_insert(ready_heap, pcb);
+#else
+    pcb_offer(ready_queues[pcb->priority], pcb);
+    SET_BIT(ready_bitmap, pcb->priority);
+#endif
 }
 
 /**
- * Removes the pcb from the ready queue
+ * Removes the pcb from the ready queue of its priority level
  */
 bool remove_pcb_from_ready_queue(pcb_t *pcb) {
     ASSERT(pcb != NULL);
-    return pcb_remove(ready_queue, pcb);
+    if(pcb->rt_period != 0) {
+        return pcb_remove(rt_ready_queue, pcb) || pcb_remove(rt_wait_queue, pcb);
+    }
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    return pcb_heap_remove(ready_heap, pcb);
+#else
+    pcb_queue_t *queue = ready_queues[pcb->priority];
+    bool removed = pcb_remove(queue, pcb);
+    if(pcb_size(queue) == 0) {
+        CLEAR_BIT(ready_bitmap, pcb->priority);
+    }
+    return removed;
+#endif
 }
 
 /**
- * Adds the pcb to the blocked queue
+ * Adds the pcb to a queue of processes blocked on another process: its
+ * senders, receivers or waiters queue
  */
-void add_pcb_to_blocked_queue(pcb_t *pcb) {
-    ASSERT(pcb != NULL);
+void add_pcb_to_blocked_queue(pcb_t *pcb, pcb_queue_t *queue) {
+    ASSERT(pcb != NULL && queue != NULL);
     pcb->state = PROC_STATE_BLOCKED;
-    pcb_offer(blocked_queue, pcb);
+    pcb_offer(queue, pcb);
 }
 
 /**
- * Removes the pcb from the blocked queue
+ * Adds the pcb to the queue of processes blocked receiving from anyone
+ */
+void add_pcb_to_any_receivers(pcb_t *pcb) {
+    add_pcb_to_blocked_queue(pcb, any_receivers);
+}
+
+/**
+ * Removes the pcb from whichever blocked queue it is on, and disarms the
+ * timeout of a timed send or recv.
+ * Returns false if the pcb is not blocked on send, recv or wait.
  */
 bool remove_pcb_from_blocked_queue(pcb_t *pcb) {
     ASSERT(pcb != NULL);
-    return pcb_remove(blocked_queue, pcb);
+    if(pcb->state != PROC_STATE_BLOCKED || pcb->queue == NULL) {
+        return FALSE;
+    }
+
+    switch(pcb->blocked_status) {
+        case BLOCKED_STATUS_SEND:
+        case BLOCKED_STATUS_RECEIVE:
+        case BLOCKED_STATUS_WAITING:
+            cancel_timeout(pcb);
+            return pcb_remove(pcb->queue, pcb);
+        default:
+            return FALSE;
+    }
 }
 
 /**
- * Peeks the next sender pcb
+ * Unblock every pcb sending to, receiving from, or waiting on the given pcb
+ * and add them to the ready queue. Senders and receivers fail with
+ * SYSPID_DNE, waiters return normally.
  */
-pcb_t *peek_next_sender(void) {
-    int size = pcb_size(blocked_queue);
-    pcb_t *result = NULL;
-    for(int i=0; i<size; i++) {
-        pcb_t *entry = pcb_poll(blocked_queue);
-        if(result == NULL && entry->blocked_status == BLOCKED_STATUS_SEND) {
-            result = entry;
-        }
-        pcb_offer(blocked_queue, entry);
+void unblock_pcbs_blocked_on(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+    pcb_t *entry;
+
+    while((entry = pcb_poll(pcb->senders)) != NULL) {
+        cancel_timeout(entry);
+        entry->blocked_id = 0;
+        entry->ret = SYSPID_DNE;
+        add_pcb_to_ready_queue(entry);
+    }
+
+    while((entry = pcb_poll(pcb->receivers)) != NULL) {
+        cancel_timeout(entry);
+        entry->blocked_id = 0;
+        entry->ret = SYSPID_DNE;
+        add_pcb_to_ready_queue(entry);
+    }
+
+    while((entry = pcb_poll(pcb->waiters)) != NULL) {
+        entry->blocked_id = 0;
+        add_pcb_to_ready_queue(entry);
     }
-    return result;
 }
 
 /**
- * Peeks the next any receiver pcb
+ * Get the real-time pcb with the earliest deadline. Otherwise get the next pcb
+ * from the highest priority non-empty ready queue, or the pcb with the lowest
+ * pass under the stride policy.
+ * Returns null if no process is ready.
  */
-pcb_t *peek_any_receiver(void) {
-    int size = pcb_size(blocked_queue);
-    pcb_t *result = NULL;
-    for(int i=0; i<size; i++) {
-        pcb_t *entry = pcb_poll(blocked_queue);
-        if(result == NULL && entry->blocked_id == 0) {
-            result = entry;
+pcb_t *get_next_pcb(void) {
+    pcb_t *next_pcb = pcb_poll(rt_ready_queue);
+    if(next_pcb != NULL) {
+        next_pcb->state = PROC_STATE_RUNNING;
+        next_pcb->cpu_time++;
+        next_pcb->quantum_left = next_pcb->quantum;
+        return next_pcb;
+    }
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    next_pcb = pcb_heap_poll(ready_heap);
+    if(next_pcb == NULL) {
+        return NULL;
+    }
+    global_pass = next_pcb->pass;
+#else
+    if(ready_bitmap == 0) {
+        return NULL;
+    }
+
+    int priority = find_first_set(ready_bitmap);
+    pcb_queue_t *queue = ready_queues[priority];
+    next_pcb = pcb_poll(queue);
+    if(pcb_size(queue) == 0) {
+        CLEAR_BIT(ready_bitmap, priority);
+    }
+#endif
+
+    next_pcb->state = PROC_STATE_RUNNING;
+    next_pcb->cpu_time++;
+    next_pcb->quantum_left = next_pcb->quantum;
+    return next_pcb;
+}
+
+/**
+ * Take the ready pcb to run now if get_next_pcb() could have picked it: no
+ * real-time pcb is ready, and the pcb is on the highest ready priority level,
+ * or has the lowest pass under the stride policy. The pcb is accounted like
+ * any pcb get_next_pcb() picks.
+ * Returns whether the pcb was taken.
+ */
+bool take_pcb_if_next(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    if(pcb->state != PROC_STATE_READY || pcb->rt_period != 0 || pcb_size(rt_ready_queue) > 0) {
+        return FALSE;
+    }
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    pcb_t *lowest = pcb_heap_peek(ready_heap);
+    if(lowest == NULL || (long)(pcb->pass - lowest->pass) > 0 || !pcb_heap_remove(ready_heap, pcb)) {
+        return FALSE;
+    }
+    global_pass = pcb->pass;
+#else
+    if(ready_bitmap == 0 || find_first_set(ready_bitmap) != pcb->priority
+            || !remove_pcb_from_ready_queue(pcb)) {
+        return FALSE;
+    }
+#endif
+
+    pcb->state = PROC_STATE_RUNNING;
+    pcb->cpu_time++;
+    pcb->quantum_left = pcb->quantum;
+    return TRUE;
+}
+
+/**
+ * Returns whether no process is ready to run
+ */
+bool ready_queue_empty(void) {
+    if(pcb_size(rt_ready_queue) > 0) {
+        return FALSE;
+    }
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    return pcb_heap_size(ready_heap) == 0;
+#else
+    return ready_bitmap == 0;
+#endif
+}
+
+/**
+ * Returns whether a ready pcb should take the cpu from the running pcb before
+ * its quantum ends: any real-time pcb over a normal one, an earlier deadline
+ * among real-time pcbs, or a higher priority level. The stride policy only
+ * rotates on quantum boundaries.
+ */
+bool ready_pcb_preempts(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    pcb_t *rt_head = pcb_peek(rt_ready_queue);
+    if(rt_head != NULL) {
+        return pcb->rt_period == 0 || deadline_before(rt_head, pcb);
+    }
+    if(pcb->rt_period != 0) {
+        return FALSE;
+    }
+
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+    return FALSE;
+#else
+    return ready_bitmap != 0 && find_first_set(ready_bitmap) < pcb->priority;
+#endif
+}
+
+/**
+ * Change the priority of the pcb. If the pcb is ready it is moved to the
+ * tail of the ready queue of its new priority level.
+ */
+void set_pcb_priority(pcb_t *pcb, int priority) {
+    ASSERT(pcb != NULL);
+    ASSERT(priority >= PRIORITY_HIGHEST && priority <= PRIORITY_LOWEST);
+
+    if(pcb->state == PROC_STATE_READY && remove_pcb_from_ready_queue(pcb)) {
+        pcb->priority = priority;
+        add_pcb_to_ready_queue(pcb);
+        return;
+    }
+
+    pcb->priority = priority;
+    kinfo_publish_pcb(pcb);
+}
+
+/**
+ * Return every active pcb to its base priority
+ */
+void reset_pcb_priorities(void) {
+    for(int i = 0; i < PCB_TABLE_SIZE; i++) {
+        pcb_t *pcb = &pcb_array[i];
+        if(pcb->state != PROC_STATE_STOPPED && pcb->priority != pcb->base_priority) {
+            set_pcb_priority(pcb, pcb->base_priority);
         }
-        pcb_offer(blocked_queue, entry);
     }
-    return result;
 }
 
 /**
- * Unblock the pcbs waiting for the given pid from
- * the blocked queue and adds it to the ready queue
+ * Start the next job of every real-time pcb whose period has elapsed, and
+ * count a miss, once, for every job still unfinished at its deadline
  */
-void unblock_pcb_waiting_for_pid(pid_t pid) {
-    int size = pcb_size(blocked_queue);
-    for(int i=0; i<size; i++) {
-        pcb_t *entry = pcb_poll(blocked_queue);
-        if(entry->blocked_id == pid) {
-            entry->blocked_id = 0;
-            add_pcb_to_ready_queue(entry);
-        } else {
-            add_pcb_to_blocked_queue(entry);
+void release_rt_pcbs(unsigned long now) {
+    for(int i = 0; i < PCB_TABLE_SIZE; i++) {
+        pcb_t *pcb = &pcb_array[i];
+        if(pcb->state == PROC_STATE_STOPPED || pcb->rt_period == 0) {
+            continue;
+        }
+
+        // Ticks may have been skipped, so the deadline can already be behind us
+        if(!pcb->rt_job_missed && rt_job_unfinished(pcb)
+                && (long)(now - pcb->rt_abs_deadline) >= 0) {
+            pcb->rt_job_missed = TRUE;
+            sched_rt_missed(pcb);
+        }
+
+        if((long)(now - (pcb->rt_release + pcb->rt_period)) >= 0) {
+            pcb->rt_release = now;
+            pcb->rt_abs_deadline = now + pcb->rt_deadline;
+            pcb->rt_budget_left = pcb->rt_budget;
+            pcb->rt_job_done = FALSE;
+            pcb->rt_job_missed = FALSE;
+            if(pcb_remove(rt_wait_queue, pcb)) {
+                add_pcb_to_ready_queue(pcb);
+            }
         }
     }
 }
 
 /**
- * Get the next pcb in the ready queue
+ * Whether the current job of a real-time pcb has work left. A job ends when
+ * the process yields or uses its whole budget.
  */
-pcb_t *get_next_pcb(void) {
-    pcb_t *next_pcb = pcb_poll(ready_queue);
-    next_pcb->state = PROC_STATE_RUNNING;
-    next_pcb->cpu_time++;
-    return next_pcb;
+static bool rt_job_unfinished(pcb_t *pcb) {
+    return !pcb->rt_job_done && pcb->rt_budget_left > 0;
+}
+
+/**
+ * Orders real-time pcbs by absolute deadline, handling wrap around
+ */
+static bool deadline_before(pcb_t *a, pcb_t *b) {
+    return (long)(a->rt_abs_deadline - b->rt_abs_deadline) < 0;
+}
+
+#if SCHED_POLICY != SCHED_POLICY_STRIDE
+/**
+ * Returns the index of the lowest set bit in the bitmap, which is the
+ * highest priority level with a ready process. Bitmap must be non-zero.
+ */
+static int find_first_set(unsigned long bitmap) {
+    int index;
+    __asm__ volatile( " \
+        bsfl %1, %0 \n"
+        : "=r" (index)
+        : "rm" (bitmap)
+    );
+    return index;
 }
+#endif
 
 /**
  * Returns the next free available pcb from the pcb table.
@@ -166,7 +453,8 @@ pcb_t *get_free_pcb(void) {
 pcb_t *pid_to_pcb(pid_t pid) {
     if (pid >= 1) {
         pcb_t *pcb = &pcb_array[(pid - 1) % PCB_TABLE_SIZE];
-        if (pcb->state != PROC_STATE_STOPPED) {
+        // The slot may have been reused by a later process
+        if (pcb->pid == pid && pcb->state != PROC_STATE_STOPPED) {
             return pcb;
         }
     }
@@ -183,13 +471,19 @@ void cleanup_pcb(pcb_t *pcb) {
     remove_pcb_from_ready_queue(pcb);
     remove_pcb_from_blocked_queue(pcb);
     remove_pcb_from_sleep_queue(pcb);
+    sched_rt_leave(pcb);
     
-    unblock_pcb_waiting_for_pid(pcb->pid);
+    unblock_pcbs_blocked_on(pcb);
     add_pcb_to_stopped_queue(pcb);
     
     /* Free all alloced mem */
-    kfree(pcb->stack_start);
-    kfree(pcb->signal_table);
+    free_stack(pcb->stack_start, pcb->stack_order);
+    if (pcb->signal_table != NULL) {
+        free_signal_table(pcb->signal_table);
+        pcb->signal_table = NULL;
+    }
+    set_mailbox(pcb, 0);
+    region_release_all(pcb);
 }
 
 /**
@@ -201,19 +495,37 @@ void dump_stopped_queue(void) {
 }
 
 /**
- * Print ready queue to console
+ * Print the real-time and non-empty ready queues to console
  */
 void dump_ready_queue(void) {
-	kprintf("Ready queue: \n");
-	dump_pcb_queue(ready_queue);
+	kprintf("Real-time ready queue: \n");
+    dump_pcb_queue(rt_ready_queue);
+	kprintf("Real-time waiting queue: \n");
+    dump_pcb_queue(rt_wait_queue);
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+	kprintf("Ready heap (global pass %d): \n", global_pass);
+    dump_pcb_heap(ready_heap);
+#else
+	kprintf("Ready queues (bitmap %x): \n", ready_bitmap);
+    for(int i = 0; i < PRIORITY_LEVELS; i++) {
+        if(CHECK_BIT(ready_bitmap, i)) {
+            kprintf("Priority %d: ", i);
+            dump_pcb_queue(ready_queues[i]);
+        }
+    }
+#endif
 }
 
 /**
- * Print blocked queue to console
+ * Print the queues of processes blocked on the pcb to console
  */
-void dump_blocked_queue(void) {
-	kprintf("Blocked queue: \n");
-	dump_pcb_queue(blocked_queue);
+void dump_blocked_queues(pcb_t *pcb) {
+	kprintf("Senders to %d: \n", pcb->pid);
+	dump_pcb_queue(pcb->senders);
+	kprintf("Receivers from %d: \n", pcb->pid);
+	dump_pcb_queue(pcb->receivers);
+	kprintf("Waiting on %d: \n", pcb->pid);
+	dump_pcb_queue(pcb->waiters);
 }
 
 /**
@@ -227,6 +539,9 @@ int fill_processStatus(pcb_t *pcb, processStatuses *ps) {
   ps->pid[currentSlot] = idle_proc->pid;
   ps->status[currentSlot] = idle_proc->state;
   ps->cpuTime[currentSlot] = idle_proc->cpu_time * MS_PER_CLOCK_TICK;
+  ps->priority[currentSlot] = idle_proc->priority;
+  ps->deadlineMisses[currentSlot] = 0;
+  ps->involuntarySwitches[currentSlot] = 0;
   for (i = 0; i < PCB_TABLE_SIZE; i++) {
     if (pcb_array[i].state != PROC_STATE_STOPPED) {
       // fill in the table entry
@@ -234,6 +549,9 @@ int fill_processStatus(pcb_t *pcb, processStatuses *ps) {
       ps->pid[currentSlot] = pcb_array[i].pid;
       ps->status[currentSlot] = pcb->pid == pcb_array[i].pid ? PROC_STATE_RUNNING: pcb_array[i].state + pcb_array[i].blocked_status;
       ps->cpuTime[currentSlot] = pcb_array[i].cpu_time * MS_PER_CLOCK_TICK;
+      ps->priority[currentSlot] = pcb_array[i].priority;
+      ps->deadlineMisses[currentSlot] = pcb_array[i].rt_misses;
+      ps->involuntarySwitches[currentSlot] = pcb_array[i].involuntary_switches;
     }
   }
 
@@ -0,0 +1,143 @@
+/* pcbheap.c : process min-heap related functions, used by the stride policy
+ *
+ * Called from pcb.c:
+ *  init_pcb_heap() - Initialize a heap used to hold pcb's
+ *  pcb_heap_size() - Return size of the heap
+ *  pcb_heap_peek() - The pcb with the lowest pass, left in the heap
+ *  pcb_heap_poll() - Remove the pcb with the lowest pass from the heap
+ *  pcb_heap_insert() - Add a pcb to the heap
+ *  pcb_heap_remove() - Remove a pcb from anywhere in the heap
+ *  dump_pcb_heap() - Print the heap out to the screen
+ */
+
+#include <pcb.h>
+
+static bool pass_before(pcb_t *a, pcb_t *b);
+static void heap_swap(pcb_heap_t *heap, int i, int j);
+static void sift_up(pcb_heap_t *heap, int index);
+static void sift_down(pcb_heap_t *heap, int index);
+
+/*
+ * Allocate memory to be used by a new heap
+ */
+pcb_heap_t *init_pcb_heap(void) {
+    pcb_heap_t *heap = (pcb_heap_t *) kmalloc(sizeof(pcb_heap_t));
+    heap->size = 0;
+    return heap;
+}
+
+/*
+ * Return the size of the given heap
+ */
+int pcb_heap_size(pcb_heap_t *heap) {
+    return heap->size;
+}
+
+/*
+ * Return the pcb with the lowest pass without removing it
+ * Return null if heap empty
+ */
+pcb_t *pcb_heap_peek(pcb_heap_t *heap) {
+    return heap->size > 0 ? heap->entries[0] : NULL;
+}
+
+/*
+ * Remove the pcb with the lowest pass from the heap
+ * Return null if heap empty
+ */
+pcb_t *pcb_heap_poll(pcb_heap_t *heap) {
+    if(heap->size == 0) {
+        return NULL;
+    }
+
+    pcb_t *node = heap->entries[0];
+    pcb_heap_remove(heap, node);
+    return node;
+}
+
+/*
+ * Add the given pcb to the given heap
+ */
+void pcb_heap_insert(pcb_heap_t *heap, pcb_t *entry) {
+    ASSERT(heap->size < PCB_TABLE_SIZE);
+    entry->heap_index = heap->size;
+    heap->entries[heap->size] = entry;
+    heap->size++;
+    sift_up(heap, entry->heap_index);
+}
+
+/*
+ * Removes a pcb from within the heap
+ */
+bool pcb_heap_remove(pcb_heap_t *heap, pcb_t *entry) {
+    int index = entry->heap_index;
+    if(index < 0 || index >= heap->size || heap->entries[index] != entry) {
+        return FALSE;
+    }
+
+    heap->size--;
+    if(index != heap->size) {
+        heap_swap(heap, index, heap->size);
+        sift_up(heap, index);
+        sift_down(heap, index);
+    }
+
+    entry->heap_index = -1;
+    return TRUE;
+}
+
+/*
+ * Print the pid's and passes of pcb's in the heap to the screen
+ */
+void dump_pcb_heap(pcb_heap_t *heap) {
+    for(int i = 0; i < heap->size; i++) {
+        kprintf("[pid: %d, pass: %d], ", heap->entries[i]->pid, heap->entries[i]->pass);
+    }
+
+    kprintf("\n");
+}
+
+/*
+ * Compare passes using the signed difference so wrap around is handled
+ */
+static bool pass_before(pcb_t *a, pcb_t *b) {
+    return (long)(a->pass - b->pass) < 0;
+}
+
+static void heap_swap(pcb_heap_t *heap, int i, int j) {
+    pcb_t *tmp = heap->entries[i];
+    heap->entries[i] = heap->entries[j];
+    heap->entries[j] = tmp;
+    heap->entries[i]->heap_index = i;
+    heap->entries[j]->heap_index = j;
+}
+
+static void sift_up(pcb_heap_t *heap, int index) {
+    while(index > 0) {
+        int parent = (index - 1) / 2;
+        if(!pass_before(heap->entries[index], heap->entries[parent])) {
+            return;
+        }
+        heap_swap(heap, index, parent);
+        index = parent;
+    }
+}
+
+static void sift_down(pcb_heap_t *heap, int index) {
+    while(1) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if(left < heap->size && pass_before(heap->entries[left], heap->entries[smallest])) {
+            smallest = left;
+        }
+        if(right < heap->size && pass_before(heap->entries[right], heap->entries[smallest])) {
+            smallest = right;
+        }
+        if(smallest == index) {
+            return;
+        }
+        heap_swap(heap, index, smallest);
+        index = smallest;
+    }
+}
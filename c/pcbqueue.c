@@ -2,27 +2,42 @@
  *
  * Called from pcb.c:
  *  init_pcb_queue() - Initialize a queue used to hold pcb's
+ *  free_pcb_queue() - Free a queue made by init_pcb_queue()
  *  pcb_size() - Return size of the queue
  *  pcb_poll() - Remove a pcb from the front of the queue
  *  pcb_peek() - Peek the front of the queue
  *  pcb_offer() - Add a pcb to the end of the queue
+ *  pcb_insert_before() - Add a pcb in front of another pcb in the queue
  *  pcb_remove() - Remove a pcb from the queue
+ *  pcb_insert_sorted() - Add a pcb behind every entry that should run before it
  *  dump_pcb_queue() - Print the queue out to the screen
  */
 
 #include <pcb.h>
 
+static kmem_cache_t *queue_cache;
+
 /*
  * Allocate memory to be used by a new queue
  */
 pcb_queue_t *init_pcb_queue(void) {
-    pcb_queue_t *queue = (pcb_queue_t *) kmalloc(sizeof(pcb_queue_t));
+    if (queue_cache == NULL) {
+        queue_cache = kmem_cache_create("pcb queue", sizeof(pcb_queue_t), 0);
+    }
+    pcb_queue_t *queue = (pcb_queue_t *) kmem_cache_alloc(queue_cache);
     queue->head = NULL;
     queue->tail = NULL;
     queue->size = 0;
     return queue;
 }
 
+/*
+ * Free the memory of a queue made by init_pcb_queue()
+ */
+void free_pcb_queue(pcb_queue_t *queue) {
+    kmem_cache_free(queue_cache, queue);
+}
+
 /*
  * Return the size of the given queue
  */
@@ -35,18 +50,12 @@ int pcb_size(pcb_queue_t *queue) {
  * Return null if queue empty
  */
 pcb_t *pcb_poll(pcb_queue_t *queue) {
-    if(queue->head == NULL) {
-        return NULL;
-    }
-
-    queue->size--;
     pcb_t *node = queue->head;
-    queue->head = queue->head->next;
-    if(queue->head == NULL) {
-        queue->tail = NULL;
+    if(node == NULL) {
+        return NULL;
     }
 
-    node->next = NULL;
+    pcb_remove(queue, node);
     return node;
 }
 
@@ -61,50 +70,72 @@ pcb_t *pcb_peek(pcb_queue_t *queue) {
  * Add the given pcb to the given queue
  */
 void pcb_offer(pcb_queue_t *queue, pcb_t *entry) {
-    queue->size++;
-    if(queue->head == NULL) {
+    pcb_insert_before(queue, NULL, entry);
+}
+
+/*
+ * Add the given pcb to the queue in front of curr, or at the end if curr is null
+ */
+void pcb_insert_before(pcb_queue_t *queue, pcb_t *curr, pcb_t *entry) {
+    ASSERT(curr == NULL || curr->queue == queue);
+    pcb_t *prev = curr == NULL ? queue->tail : curr->prev;
+
+    entry->queue = queue;
+    entry->prev = prev;
+    entry->next = curr;
+    if(prev == NULL) {
         queue->head = entry;
+    } else {
+        prev->next = entry;
+    }
+    if(curr == NULL) {
         queue->tail = entry;
-        entry->next = NULL;
-        return;
+    } else {
+        curr->prev = entry;
     }
-    
-    queue->tail->next = entry;
-    queue->tail = queue->tail->next;
-    entry->next = NULL;
-    return;
+    queue->size++;
 }
 
 /*
- * Removes a pcb from within queue
+ * Removes a pcb from within queue in constant time.
+ * Return false if the pcb is not in this queue
  */
 bool pcb_remove(pcb_queue_t *queue, pcb_t *entry) {
-    pcb_t *prev = NULL;
-    pcb_t *curr = queue->head;
-    while(curr != NULL && curr != entry) {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    if(curr == NULL) {
+    if(entry->queue != queue) {
         return FALSE;
     }
 
-    if(prev == NULL) {
-        pcb_poll(queue);
-        return TRUE;
+    if(entry->prev == NULL) {
+        queue->head = entry->next;
+    } else {
+        entry->prev->next = entry->next;
     }
-
-    if(curr->next == NULL) {
-        queue->tail = prev;
+    if(entry->next == NULL) {
+        queue->tail = entry->prev;
+    } else {
+        entry->next->prev = entry->prev;
     }
 
-    prev->next = curr->next;
-    curr->next = NULL;
+    entry->queue = NULL;
+    entry->prev = NULL;
+    entry->next = NULL;
     queue->size--;
     return TRUE;
 }
 
+/*
+ * Add the given pcb to the queue behind every entry for which
+ * before(entry, pcb) holds, keeping the queue sorted and FIFO among equals
+ */
+void pcb_insert_sorted(pcb_queue_t *queue, pcb_t *entry, bool (*before)(pcb_t *a, pcb_t *b)) {
+    pcb_t *curr = queue->head;
+    while(curr != NULL && !before(entry, curr)) {
+        curr = curr->next;
+    }
+
+    pcb_insert_before(queue, curr, entry);
+}
+
 /*
  * Print the pid's of pcb's in the queue to the screen
  */
@@ -0,0 +1,118 @@
+/* region.c : transferable memory regions
+ *
+ * Every process shares one flat address space, so a message does not need
+ * to be copied for another process to read it, only handed over. A region
+ * is a buffer on the kernel heap owned by one process at a time, recorded
+ * in a small table. Sending a region sends its table entry's descriptor as
+ * the message. When the rendezvous copies that descriptor, copy_message()
+ * calls region_transfer(), which makes the receiver the owner. The payload
+ * itself is never copied, so a region of any size costs the same to pass.
+ *
+ * Only the owner may send or free a region. The owner is always the process
+ * making the call, since a process blocked sending a region can't make
+ * another, so there is no in-flight state to track.
+ *
+ * Called from outside:
+ *  region_alloc() - Allocate a region owned by the process
+ *  region_free() - Free a region the process owns
+ *  region_owned() - The descriptor of a region the process owns
+ *  region_transfer() - Move a region to the receiver of its descriptor
+ *  region_release_all() - Free every region a process owns
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+
+/* A region table entry, free while owner is 0 */
+typedef struct region_entry {
+    region_t desc;   /* What the receiver of the region gets, must stay first */
+    pid_t owner;     /* The process that may use the region */
+} region_entry_t;
+
+static region_entry_t region_table[REGION_TABLE_SIZE];
+
+static region_entry_t *find_owned(pcb_t *pcb, void *base);
+
+/*
+ * Allocate a region of len bytes owned by the pcb.
+ * Returns the start of the region, or null if the table or heap is full.
+ */
+void *region_alloc(pcb_t *pcb, int len) {
+    for(int i = 0; i < REGION_TABLE_SIZE; i++) {
+        region_entry_t *entry = &region_table[i];
+        if(entry->owner != 0) {
+            continue;
+        }
+
+        entry->desc.base = kmalloc(len);
+        if(entry->desc.base == NULL) {
+            return NULL;
+        }
+        entry->desc.len = len;
+        entry->owner = pcb->pid;
+        return entry->desc.base;
+    }
+    return NULL;
+}
+
+/*
+ * Free the region starting at base.
+ * Returns 0, or SYSREGION_NOT_OWNER if the pcb does not own such a region.
+ */
+int region_free(pcb_t *pcb, void *base) {
+    region_entry_t *entry = find_owned(pcb, base);
+    if(entry == NULL) {
+        return SYSREGION_NOT_OWNER;
+    }
+
+    kfree(entry->desc.base);
+    entry->desc.base = NULL;
+    entry->owner = 0;
+    return 0;
+}
+
+/*
+ * The descriptor of the region starting at base, to be sent as a message.
+ * Returns null if the pcb does not own such a region.
+ */
+region_t *region_owned(pcb_t *pcb, void *base) {
+    region_entry_t *entry = find_owned(pcb, base);
+    return entry != NULL ? &entry->desc : NULL;
+}
+
+/*
+ * Called for every message copied by a rendezvous. If the message is the
+ * descriptor of a region the sender owns and the receiver took all of it,
+ * the receiver becomes the owner of the region.
+ */
+void region_transfer(pcb_t *sender, void *send_buffer, int len, pcb_t *receiver) {
+    region_entry_t *entry = (region_entry_t *)send_buffer;
+    if(entry < region_table || entry >= region_table + REGION_TABLE_SIZE
+            || len < (int)sizeof(region_t) || entry->owner != sender->pid) {
+        return;
+    }
+    entry->owner = receiver->pid;
+}
+
+/*
+ * Free every region the pcb owns
+ */
+void region_release_all(pcb_t *pcb) {
+    for(int i = 0; i < REGION_TABLE_SIZE; i++) {
+        if(region_table[i].owner == pcb->pid) {
+            region_free(pcb, region_table[i].desc.base);
+        }
+    }
+}
+
+/*
+ * The table entry of the region starting at base owned by the pcb, or null
+ */
+static region_entry_t *find_owned(pcb_t *pcb, void *base) {
+    for(int i = 0; i < REGION_TABLE_SIZE; i++) {
+        if(region_table[i].owner == pcb->pid && region_table[i].desc.base == base) {
+            return &region_table[i];
+        }
+    }
+    return NULL;
+}
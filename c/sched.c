@@ -0,0 +1,320 @@
+/* sched.c : scheduling policy
+ *
+ * The ready queues themselves live in pcb.c. This file decides how process
+ * priorities change over time for the policy selected with SCHED_POLICY.
+ * Under SCHED_POLICY_PRIORITY priorities only change through syssetprio().
+ * Under SCHED_POLICY_MLFQ a process that uses its whole quantum drops a level,
+ * a process that blocks rises a level (never above its base priority), and
+ * every MLFQ_BOOST_TICKS all processes are returned to their base priority.
+ * Under SCHED_POLICY_STRIDE the running process is charged its stride on
+ * every tick, and pcb.c always runs the ready process with the lowest pass.
+ *
+ * Independently of the policy, a process may join the real-time class with
+ * syssetrt(). Real-time processes run ahead of all others, earliest absolute
+ * deadline first. Each job may use rt_budget ticks per rt_period; once the
+ * budget is used up, or the job ends with sysyield(), the process waits for
+ * its next release. Admission is refused if the total density
+ * (budget / min(deadline, period)) of all real-time processes would exceed 1.
+ *
+ * Each process runs for its quantum of clock ticks before the timer rotates
+ * to another ready process. When the quantum runs out and nothing else is
+ * ready the quantum is simply renewed. A process that becomes ready ahead of
+ * the running one (see ready_pcb_preempts()) takes over on the next tick.
+ *
+ * With IPC_FASTPATH, a process that blocks in recv on a partner it has just
+ * made ready hands the cpu and the rest of its quantum straight to that
+ * partner, so a request/reply round trip never waits behind the processes
+ * of the partner's level. The partner must still be one the policy would
+ * run next.
+ *
+ * Called from outside:
+ *  sched_tick() - Account a clock tick to the running process and boost if due
+ *  sched_quantum_tick() - Charge a tick to the quantum and decide whether to rotate
+ *  sched_preempted() - The running process was switched out by the timer
+ *  sched_handoff() - Pick the process to run after a recv blocks, favouring its partner
+ *  sched_blocked() - The process blocked on send/recv/sleep/wait/device
+ *  sched_set_tickets() - Set the stride tickets of a process
+ *  sched_rt_admit() - Move a process into the real-time class if it can be admitted
+ *  sched_rt_leave() - Move a process out of the real-time class
+ *  sched_rt_job_done() - The current job of a real-time process has completed
+ *  sched_rt_missed() - A real-time job was still unfinished at its deadline
+ *  sched_rt_active() - Whether any process is in the real-time class
+ *  fill_schedStatus() - Fills schedStatuses struct with the scheduler counters
+ *  dump_sched_stats() - Print the scheduler counters to console
+ */
+
+#include <xeroskernel.h>
+#include <pcb.h>
+
+static long level_ticks[PRIORITY_LEVELS];
+static long demotions;
+static long promotions;
+static long boosts;
+static int ticks_until_boost = MLFQ_BOOST_TICKS;
+static int rt_utilization;
+static long rt_misses;
+static long involuntary_switches;
+static long skipped_reschedules;
+static long ipc_handoffs;
+
+static void sched_quantum_expired(pcb_t *pcb);
+static int rt_density(unsigned int budget, unsigned int deadline);
+
+/**
+ * Account a clock tick to the running process and release the next job of
+ * any real-time process whose period has elapsed. Under MLFQ this also
+ * periodically boosts every process back to its base priority so that
+ * demoted processes cannot starve.
+ */
+void sched_tick(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    if (pcb->rt_period != 0 && pcb->rt_budget_left > 0) {
+        pcb->rt_budget_left--;
+    }
+    if (rt_utilization > 0) {
+        release_rt_pcbs(get_clock_ticks());
+    }
+
+    if (pcb->pid != 0) {
+        level_ticks[pcb->priority]++;
+#if SCHED_POLICY == SCHED_POLICY_STRIDE
+        pcb->pass += pcb->stride;
+#endif
+    }
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    ticks_until_boost--;
+    if (ticks_until_boost <= 0) {
+        ticks_until_boost = MLFQ_BOOST_TICKS;
+        reset_pcb_priorities();
+        boosts++;
+    }
+#else
+    (void)ticks_until_boost;
+#endif
+}
+
+/**
+ * Charge the current clock tick to the quantum of the running process.
+ * Returns TRUE if the dispatcher should put the process back on the ready
+ * queue and pick again, which is only worthwhile if another process is ready.
+ */
+bool sched_quantum_tick(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    if (pcb->pid == 0) {
+        return !ready_queue_empty();
+    }
+
+    // A real-time job out of budget must wait for its next release
+    if (pcb->rt_period != 0 && pcb->rt_budget_left == 0) {
+        return TRUE;
+    }
+
+    pcb->quantum_left--;
+    if (pcb->quantum_left > 0) {
+        return ready_pcb_preempts(pcb);
+    }
+
+    sched_quantum_expired(pcb);
+    if (ready_queue_empty()) {
+        pcb->quantum_left = pcb->quantum;
+        skipped_reschedules++;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Called when the timer switches the running process out for another
+ */
+void sched_preempted(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    pcb->involuntary_switches++;
+    involuntary_switches++;
+}
+
+/**
+ * Called when from has blocked in recv waiting on to. If to is ready and the
+ * policy would run it next anyway, to runs next on the rest of from's quantum
+ * without waiting behind the others of its level. Under the stride policy
+ * that means to has the lowest pass. Real-time processes keep to deadline
+ * order and never take part.
+ * Returns the process to run next, which may be null if none is ready.
+ */
+pcb_t *sched_handoff(pcb_t *from, pcb_t *to) {
+    ASSERT(from != NULL);
+
+#if IPC_FASTPATH
+    if (to != NULL && from->rt_period == 0 && take_pcb_if_next(to)) {
+        to->quantum_left = from->quantum_left > 0 ? from->quantum_left : to->quantum;
+        ipc_handoffs++;
+        return to;
+    }
+#else
+    (void)ipc_handoffs;
+#endif
+
+    return get_next_pcb();
+}
+
+/**
+ * Called when a process used its whole quantum. Under MLFQ the process drops
+ * one level.
+ */
+static void sched_quantum_expired(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    if (pcb->pid != 0 && pcb->rt_period == 0 && pcb->priority < PRIORITY_LOWEST) {
+        set_pcb_priority(pcb, pcb->priority + 1);
+        demotions++;
+    }
+#endif
+}
+
+/**
+ * Called when a process gives up the cpu by blocking. Under MLFQ the
+ * process rises one level, but never above its base priority.
+ */
+void sched_blocked(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+#if SCHED_POLICY == SCHED_POLICY_MLFQ
+    if (pcb->priority > pcb->base_priority) {
+        set_pcb_priority(pcb, pcb->priority - 1);
+        promotions++;
+    }
+#endif
+}
+
+/**
+ * Set the stride tickets of the process. The pass is left alone so the new
+ * share takes effect from the next tick charged to the process.
+ */
+void sched_set_tickets(pcb_t *pcb, int tickets) {
+    ASSERT(pcb != NULL);
+    ASSERT(tickets > 0 && tickets <= STRIDE_MAX_TICKETS);
+
+    pcb->tickets = tickets;
+    pcb->stride = STRIDE_ONE / tickets;
+}
+
+/**
+ * Move the process into the real-time class with the given period, budget and
+ * relative deadline in clock ticks. A process already in the class has its
+ * parameters replaced. Its first job is released immediately.
+ * Returns 0 if admitted, SYSRT_REJECTED if the utilization would exceed 1.
+ */
+int sched_rt_admit(pcb_t *pcb, unsigned int period, unsigned int budget, unsigned int deadline) {
+    ASSERT(pcb != NULL);
+    ASSERT(budget > 0 && budget <= deadline && deadline <= period);
+
+    int old_density = pcb->rt_period ? rt_density(pcb->rt_budget, pcb->rt_deadline) : 0;
+    int new_density = rt_density(budget, deadline);
+    if (rt_utilization - old_density + new_density > RT_UTIL_SCALE) {
+        return SYSRT_REJECTED;
+    }
+
+    rt_utilization += new_density - old_density;
+    unsigned long now = get_clock_ticks();
+    pcb->rt_period = period;
+    pcb->rt_budget = budget;
+    pcb->rt_deadline = deadline;
+    pcb->rt_release = now;
+    pcb->rt_abs_deadline = now + deadline;
+    pcb->rt_budget_left = budget;
+    pcb->rt_job_done = FALSE;
+    pcb->rt_job_missed = FALSE;
+    return 0;
+}
+
+/**
+ * Move the process out of the real-time class, returning its utilization.
+ * The process must not be on any ready queue.
+ */
+void sched_rt_leave(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    if (pcb->rt_period != 0) {
+        rt_utilization -= rt_density(pcb->rt_budget, pcb->rt_deadline);
+        pcb->rt_period = 0;
+    }
+}
+
+/**
+ * The current job of the real-time process completed. The process waits for
+ * its next release once it is added back to the ready queue.
+ */
+void sched_rt_job_done(pcb_t *pcb) {
+    ASSERT(pcb != NULL && pcb->rt_period != 0);
+
+    pcb->rt_job_done = TRUE;
+    pcb->rt_budget_left = 0;
+}
+
+/**
+ * Record that the current job of the real-time process missed its deadline
+ */
+void sched_rt_missed(pcb_t *pcb) {
+    ASSERT(pcb != NULL);
+
+    pcb->rt_misses++;
+    rt_misses++;
+}
+
+/**
+ * Whether any process is in the real-time class, in which case every clock
+ * tick must be delivered on time to release jobs
+ */
+bool sched_rt_active(void) {
+    return rt_utilization > 0;
+}
+
+/**
+ * Density of a real-time process out of RT_UTIL_SCALE, rounded up so that
+ * admission errs on the safe side
+ */
+static int rt_density(unsigned int budget, unsigned int deadline) {
+    return (budget * RT_UTIL_SCALE + deadline - 1) / deadline;
+}
+
+/**
+ * Fills the schedStatuses struct with the scheduler counters
+ */
+void fill_schedStatus(schedStatuses *ss) {
+    ss->policy = SCHED_POLICY;
+    for (int i = 0; i < PRIORITY_LEVELS; i++) {
+        ss->levelTicks[i] = level_ticks[i];
+    }
+    ss->demotions = demotions;
+    ss->promotions = promotions;
+    ss->boosts = boosts;
+    ss->rtUtilization = rt_utilization;
+    ss->rtMisses = rt_misses;
+    ss->ticksAvoided = get_ticks_avoided();
+    ss->involuntarySwitches = involuntary_switches;
+    ss->skippedReschedules = skipped_reschedules;
+    ss->ipcHandoffs = ipc_handoffs;
+}
+
+/**
+ * Print the scheduler counters to console
+ */
+void dump_sched_stats(void) {
+    kprintf("Scheduler policy: %d, demotions: %d, promotions: %d, boosts: %d\n",
+            SCHED_POLICY, demotions, promotions, boosts);
+    kprintf("Real-time utilization: %d/%d, deadline misses: %d\n",
+            rt_utilization, RT_UTIL_SCALE, rt_misses);
+    kprintf("Ticks avoided while idle: %d\n", get_ticks_avoided());
+    kprintf("Involuntary switches: %d, skipped reschedules: %d\n",
+            involuntary_switches, skipped_reschedules);
+    kprintf("Ipc handoffs: %d\n", ipc_handoffs);
+    for (int i = 0; i < PRIORITY_LEVELS; i++) {
+        if (level_ticks[i] != 0) {
+            kprintf("Priority %d: %d ticks\n", i, level_ticks[i]);
+        }
+    }
+}
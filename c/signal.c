@@ -3,12 +3,19 @@
  *  signal() - Prepares the signal with the signalNumber to pid
  *  set_pcb_signal() - Mark signal for delivery
  *  deliver_highest_priority_signal() - Delivers any pending signal with the highest priority
+ *  get_signal_handler() - The handler a process has for a signal
+ *  set_signal_handler() - Install a handler, allocating the signal table on first use
+ *  alloc_signal_table() - Allocate a signal table with no handlers installed
+ *  free_signal_table() - Free a signal table
  */
 
 #include <xeroskernel.h>
 #include <xeroslib.h>
 #include <pcb.h>
 
+/* Every process has a signal table of the same size */
+static kmem_cache_t *signal_table_cache;
+
 /*
  * sets up the signal trampoline
  */
@@ -47,7 +54,7 @@ int signal(pid_t pid, int signalNumber) {
 
     // push handler on stack
     stack_ptr -= 1;
-    *stack_ptr = (int)process->signal_table[signalNumber];
+    *stack_ptr = (int)get_signal_handler(process, signalNumber);
 
     // push a placeholder return address (this is never used)
     stack_ptr -= 1;
@@ -72,7 +79,7 @@ int set_pcb_signal(pcb_t *pcb, int signal) {
     }
     
     // Only set signal if the handler is not null (ie. ignored)
-    if (pcb->signal_table[signal]) {
+    if (get_signal_handler(pcb, signal)) {
         SET_BIT(pcb->signals_pending, signal);
 
         // If process is blocked, we need to unblock it and set the return value accordingly
@@ -92,6 +99,9 @@ int set_pcb_signal(pcb_t *pcb, int signal) {
                     remove_pcb_from_blocked_queue(pcb);
                     add_pcb_to_ready_queue(pcb);
                     break;
+                case BLOCKED_STATUS_PERIOD:
+                    // Delivered when the next real-time job is released
+                    break;
                 default:
                     ASSERT(0);
             }
@@ -120,3 +130,56 @@ void deliver_highest_priority_signal(pcb_t *pcb) {
     }
 }
 
+/*
+ * The handler the process has installed for the signal. A process without a
+ * signal table only has the default handler that terminates it on
+ * KILL_SIGNAL_NUM.
+ */
+funcptr_args get_signal_handler(pcb_t *pcb, int signal) {
+    if (pcb->signal_table == NULL) {
+        return signal == KILL_SIGNAL_NUM ? (funcptr_args)&sysstop : NULL;
+    }
+    return pcb->signal_table[signal];
+}
+
+/*
+ * Install the handler for the signal. The first handler a process sets
+ * allocates its signal table, with the default KILL_SIGNAL_NUM handler.
+ * Returns 0 on success, SYSHANDLER_NO_MEMORY if the table can't be allocated.
+ */
+int set_signal_handler(pcb_t *pcb, int signal, funcptr_args handler) {
+    if (pcb->signal_table == NULL) {
+        pcb->signal_table = alloc_signal_table();
+        if (pcb->signal_table == NULL) {
+            return SYSHANDLER_NO_MEMORY;
+        }
+        pcb->signal_table[KILL_SIGNAL_NUM] = (funcptr_args)&sysstop;
+    }
+
+    pcb->signal_table[signal] = handler;
+    return 0;
+}
+
+/*
+ * Allocate a signal table with no handlers installed.
+ * Returns null if out of memory.
+ */
+funcptr_args *alloc_signal_table(void) {
+    if (signal_table_cache == NULL) {
+        signal_table_cache = kmem_cache_create("signal table",
+                SIGNAL_TABLE_SIZE * sizeof(funcptr_args), 0);
+    }
+
+    funcptr_args *signal_table = kmem_cache_alloc(signal_table_cache);
+    if (signal_table != NULL) {
+        memset(signal_table, 0, SIGNAL_TABLE_SIZE * sizeof(funcptr_args));
+    }
+    return signal_table;
+}
+
+/*
+ * Free a signal table
+ */
+void free_signal_table(funcptr_args *signal_table) {
+    kmem_cache_free(signal_table_cache, signal_table);
+}
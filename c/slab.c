@@ -0,0 +1,125 @@
+/* slab.c : object caches for fixed size kernel objects
+ *
+ * A cache hands out objects of one size carved from slabs taken from the
+ * page allocator, one page each unless an object needs more. Free objects
+ * are linked through their first word, so an object costs exactly its size
+ * rounded up to the cache's alignment, with no header. Slabs stay with
+ * their cache once allocated.
+ *
+ * Called from outside:
+ *  kmem_cache_create() - Create a cache of objects of the given size and alignment
+ *  kmem_cache_alloc() - Take an object from a cache
+ *  kmem_cache_free() - Return an object to its cache
+ *  kmem_cache_dump() - Print the usage of every cache to console
+ */
+
+#include <xeroskernel.h>
+#include <i386.h>
+
+#define KMEM_MAX_CACHES 8         /* Caches that can exist at once */
+
+/* A cache of fixed size objects */
+struct kmem_cache {
+    char *name;
+    size_t obj_size;     /* Object size rounded up to the alignment */
+    size_t align;        /* Alignment of every object */
+    int slab_order;      /* Slabs are blocks of 2^slab_order pages */
+    int objs_per_slab;
+    void *free_objs;     /* Free objects, linked through their first word */
+    int slabs;           /* Slabs allocated */
+    int in_use;          /* Objects handed out */
+};
+
+static kmem_cache_t caches[KMEM_MAX_CACHES];
+static int num_caches;
+
+static bool grow_cache(kmem_cache_t *cache);
+
+/**
+ * Create a cache of objects of the given size. align must be a power of two
+ * no bigger than a page, 0 aligns objects to a word.
+ * Returns the cache, or null if there are too many caches.
+ */
+kmem_cache_t *kmem_cache_create(char *name, size_t size, size_t align) {
+    if (num_caches == KMEM_MAX_CACHES) {
+        LOG("kmem_cache_create out of caches for %s\n", name);
+        return NULL;
+    }
+
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    if (size < sizeof(void *)) {
+        size = sizeof(void *);
+    }
+    ASSERT((align & (align - 1)) == 0 && align <= NBPG);
+
+    kmem_cache_t *cache = &caches[num_caches++];
+    cache->name = name;
+    cache->align = align;
+    cache->obj_size = (size + align - 1) & ~(align - 1);
+    cache->slab_order = kpage_order(cache->obj_size);
+    cache->objs_per_slab = (NBPG << cache->slab_order) / cache->obj_size;
+    cache->free_objs = NULL;
+    cache->slabs = 0;
+    cache->in_use = 0;
+    return cache;
+}
+
+/**
+ * Take an object from the cache, growing it by a slab if it has none free.
+ * Returns null if no memory is left for a new slab.
+ */
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    ASSERT(cache != NULL);
+    if (cache->free_objs == NULL && !grow_cache(cache)) {
+        return NULL;
+    }
+
+    void *obj = cache->free_objs;
+    cache->free_objs = *(void **)obj;
+    cache->in_use++;
+    return obj;
+}
+
+/**
+ * Return an object to the cache it came from
+ */
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    ASSERT(cache != NULL && obj != NULL);
+    *(void **)obj = cache->free_objs;
+    cache->free_objs = obj;
+    cache->in_use--;
+}
+
+/**
+ * Carve a new slab into objects and put them all on the free list.
+ * Returns false if the slab could not be allocated.
+ */
+static bool grow_cache(kmem_cache_t *cache) {
+    char *obj = kpage_alloc(cache->slab_order);
+    if (obj == NULL) {
+        return FALSE;
+    }
+
+    // Slabs are page aligned, so every object is aligned too
+    for (int i = 0; i < cache->objs_per_slab; i++) {
+        *(void **)obj = cache->free_objs;
+        cache->free_objs = obj;
+        obj += cache->obj_size;
+    }
+    cache->slabs++;
+    return TRUE;
+}
+
+/**
+ * Print the usage of every cache to console
+ */
+void kmem_cache_dump(void) {
+    for (int i = 0; i < num_caches; i++) {
+        kmem_cache_t *cache = &caches[i];
+        kprintf("Cache %s: %d byte objects, %d of %d in use, %d slabs\n",
+                cache->name, cache->obj_size, cache->in_use,
+                cache->slabs * cache->objs_per_slab, cache->slabs);
+    }
+}
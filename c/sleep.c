@@ -1,107 +1,498 @@
 /* sleep.c : sleep device 
+ *
+ * Sleepers wait on a hierarchical timing wheel. Level 0 has a slot for each
+ * of the next WHEEL_SLOTS ticks, and every level above has slots a
+ * WHEEL_SLOTS times wider. A sleeper goes in the slot of the lowest level
+ * that reaches its wake tick, in constant time. Each time the slots of a
+ * level wrap around, the next slot of the level above is emptied into the
+ * levels below, so by its wake tick every sleeper sits in the level 0 slot
+ * that tick() wakes.
+ *
+ * The wheel links pcbs through their own timer_next/timer_prev fields rather
+ * than the pcb queue links, so a process blocked in sysrecvtim or
+ * syssendtim sits on its message queue and on the wheel at once. Whichever
+ * comes first, the message or the tick, unlinks it from the other in
+ * constant time.
+ *
+ * Sleepers in usleep() wait instead on a list ordered by the clock_ns() they
+ * wake at. Whenever the first of them is due before the next tick, timer 0
+ * is switched to a one-shot aimed at its deadline. Once the one-shot fires,
+ * the timer is aimed at the next such deadline or at the tick the periodic
+ * timer would have raised, where periodic mode resumes. Interrupts in
+ * between ticks only wake sleepers and are not accounted as ticks.
  *
  * Called from outside:
- *  sleepinit() - Intialize the sleep queue
+ *  sleepinit() - Intialize the timing wheel
  *  sleep() - The kernel implementation of the sleep syscall
+ *  usleep() - The kernel implementation of the usleep syscall
+ *  set_timeout() - Fail the blocked send or recv of a process after a time
+ *  cancel_timeout() - Disarm the timeout of a process whose send or recv completed
+ *  hrtimer_interrupt() - Wake the usleep sleepers that are due on a timer interrupt
  *  tick() - Actions that need to be performed on clock tick ie. wake sleeping processes
+ *  get_clock_ticks() - Number of clock ticks since the system started
+ *  tickless_enter() - Replace the periodic tick with a one-shot aimed at the next sleeper
+ *  tickless_exit() - Restore the periodic tick and report the ticks that passed silently
+ *  get_ticks_avoided() - Number of clock ticks that passed without a timer interrupt
  *  wake() - Wake sleeping processes and adds it to the ready queue
- *  dump_sleep_queue() - Dumps the sleep queue to stdout
+ *  dump_sleep_queue() - Dumps the sleepers in every slot to stdout
  */
 
 #include <xeroskernel.h>
 #include <xeroslib.h>
 #include <pcb.h>
+#include <i386.h>
+
+#define PIT_COUNTS_PER_TICK TIMER_DIV(CLOCK_TICKS_PER_SECOND)
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS) /* Slots per level */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_RANGE (1UL << (WHEEL_BITS * WHEEL_LEVELS)) /* Ticks the wheel reaches ahead */
+
+/* Sleepers by level and slot, each slot the head of a circular list. A level 0
+ * slot holds the sleepers that wake on one tick, a slot of level n those
+ * waking in a span of WHEEL_SLOTS^n ticks. */
+static pcb_t *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static unsigned long clock_ticks;
+
+/* State of the one-shot programmed by tickless_enter, oneshot_counts is 0 while ticking periodically */
+static unsigned int oneshot_counts;
+static unsigned int oneshot_first_tick;
+static int oneshot_ticks;
+static long ticks_avoided;
+
+#define HR_MIN_COUNTS 20          /* Shortest one-shot, so it can't expire before it is fully loaded */
+#define HR_MAX_NS 50000000UL      /* Deadlines further off than any one-shot can reach */
 
-pcb_queue_t *sleep_queue;
+/* Sleepers in usleep() by the clock_ns() they wake at */
+static pcb_queue_t hr_sleepers;
+
+/* State of the one-shot aimed at a usleep deadline. Once it fires,
+ * hr_counts_after counts are left until the tick, 0 if it ends on the tick. */
+static bool hr_armed;
+static unsigned int hr_counts;
+static unsigned int hr_counts_after;
+
+static void wheel_insert(pcb_t *pcb);
+static void wheel_link(pcb_t **slot, pcb_t *pcb);
+static void wheel_unlink(pcb_t *pcb);
+static unsigned long ms_to_ticks(unsigned int milliseconds);
+static void expire(pcb_t *pcb);
+static void cascade(void);
+static int ticks_to_next_slot(int max_ticks);
+static bool wakes_before(pcb_t *a, pcb_t *b);
+static void wake_hr_sleepers(void);
+static void hrtimer_arm(unsigned int to_tick, unsigned int next_irq);
 
 /*
- * Intialize the sleep queue
+ * Intialize the timing wheel
  */
 void sleepinit(void) {
-    sleep_queue = (pcb_queue_t *) init_pcb_queue();
+    memset(wheel, 0, sizeof(wheel));
 }
 
 /*
- * The kernel implementation of the sleep syscall
+ * The kernel implementation of the sleep syscall. The process wakes on the
+ * first tick at least the given time from now, or on the next tick if it is
+ * 0.
  */
 void sleep(pcb_t *pcb, unsigned int milliseconds) {
-    pcb->ret = milliseconds / MS_PER_CLOCK_TICK + (milliseconds % MS_PER_CLOCK_TICK ? 1 : 0);
+    pcb->wake_tick = clock_ticks + ms_to_ticks(milliseconds);
     add_pcb_to_sleep_queue(pcb);
 }
 
+/*
+ * Fail the blocked send or recv of the pcb with TIMEOUT on the first tick at
+ * least the given time from now, unless it completes first
+ */
+void set_timeout(pcb_t *pcb, unsigned int milliseconds) {
+    ASSERT(pcb->state == PROC_STATE_BLOCKED && pcb->timer_slot == NULL);
+    pcb->wake_tick = clock_ticks + ms_to_ticks(milliseconds);
+    wheel_insert(pcb);
+}
+
+/*
+ * Disarm the timeout of the pcb, if it has one
+ */
+void cancel_timeout(pcb_t *pcb) {
+    if(pcb->timer_slot != NULL) {
+        wheel_unlink(pcb);
+    }
+}
+
+/*
+ * Convert milliseconds to clock ticks, rounding up to at least one tick
+ */
+static unsigned long ms_to_ticks(unsigned int milliseconds) {
+    unsigned long ticks = milliseconds / MS_PER_CLOCK_TICK + (milliseconds % MS_PER_CLOCK_TICK ? 1 : 0);
+    return ticks > 0 ? ticks : 1;
+}
+
+/*
+ * The kernel implementation of the usleep syscall. The process wakes once
+ * clock_ns() has advanced by the given time, which without a time stamp
+ * counter means on a clock tick.
+ */
+void usleep(pcb_t *pcb, unsigned int microseconds) {
+    pcb->wake_ns = clock_ns() + (unsigned long long)microseconds * 1000;
+    pcb->state = PROC_STATE_BLOCKED;
+    pcb->blocked_status = BLOCKED_STATUS_SLEEP;
+    pcb_insert_sorted(&hr_sleepers, pcb, wakes_before);
+    if(pcb != pcb_peek(&hr_sleepers) || irqPending(TIMER_IRQ)) {
+        // The timer is already aimed at an earlier deadline, or its interrupt will aim it
+        return;
+    }
+
+    unsigned int left = readPIT();
+    if(!hr_armed) {
+        hrtimer_arm(left, left);
+    } else if(left <= hr_counts) {
+        hrtimer_arm(left + hr_counts_after, left);
+    }
+}
+
+/*
+ * Called on every timer interrupt before the tick is accounted. Wakes the
+ * usleep sleepers that are due and aims the timer at the next deadline.
+ * Returns whether the interrupt is a clock tick, FALSE for a one-shot in
+ * between ticks.
+ */
+bool hrtimer_interrupt(void) {
+    bool on_tick = !hr_armed || hr_counts_after == 0;
+    unsigned int to_tick;
+
+    if(!hr_armed) {
+        to_tick = readPIT();
+    } else {
+        // Past zero the counter keeps counting down, which tells how late we are
+        unsigned int late = (TIMER_MAX_COUNT + 1 - readPIT()) & TIMER_MAX_COUNT;
+        hr_armed = FALSE;
+        if(on_tick) {
+            initPIT(CLOCK_TICKS_PER_SECOND);
+            to_tick = PIT_COUNTS_PER_TICK;
+        } else {
+            to_tick = hr_counts_after > late ? hr_counts_after - late : 0;
+        }
+    }
+
+    wake_hr_sleepers();
+    // Between ticks nothing else will interrupt, so the tick itself must be aimed at
+    hrtimer_arm(to_tick, on_tick ? to_tick : ~0U);
+    return on_tick;
+}
+
+/*
+ * Aim the one-shot at the first usleep deadline if it comes before the next
+ * timer interrupt, next_irq counts away, or at the tick to_tick counts away
+ * if that comes first instead.
+ */
+static void hrtimer_arm(unsigned int to_tick, unsigned int next_irq) {
+    unsigned int counts = to_tick;
+    pcb_t *next = pcb_peek(&hr_sleepers);
+    if(next != NULL && clock_hires()) {
+        unsigned long long now = clock_ns();
+        unsigned long long ns = next->wake_ns > now ? next->wake_ns - now : 0;
+        if(ns < HR_MAX_NS) {
+            // In units of 100ns so the product fits in 32 bits, rounded up
+            unsigned int due = ((unsigned long)ns / 100 * (TIMER_FREQ / 1000) + 9999) / 10000;
+            counts = due < counts ? due : counts;
+        }
+    }
+
+    if(counts >= next_irq) {
+        return;
+    }
+    if(counts < HR_MIN_COUNTS) {
+        counts = HR_MIN_COUNTS;
+    }
+    initPITOneShot(counts);
+    hr_armed = TRUE;
+    hr_counts = counts;
+    hr_counts_after = to_tick > counts ? to_tick - counts : 0;
+}
+
+/*
+ * Wake the usleep sleepers whose time has come
+ */
+static void wake_hr_sleepers(void) {
+    unsigned long long now = clock_ns();
+    pcb_t *pcb;
+    while((pcb = pcb_peek(&hr_sleepers)) != NULL && pcb->wake_ns <= now) {
+        wake(pcb);
+    }
+}
+
+/*
+ * Whether usleep sleeper a wakes before b
+ */
+static bool wakes_before(pcb_t *a, pcb_t *b) {
+    return a->wake_ns < b->wake_ns;
+}
+
 /*
  * Actions that need to be performed on clock tick ie. wake sleeping processes
  */
 void tick(void) {
-    pcb_t *head = peek_pcb_from_sleep_queue();
-    if(head == NULL) {
+    clock_ticks++;
+    if((clock_ticks & WHEEL_MASK) == 0) {
+        cascade();
+    }
+
+    pcb_t **slot = &wheel[0][clock_ticks & WHEEL_MASK];
+    while(*slot != NULL) {
+        expire(*slot);
+    }
+}
+
+/*
+ * Wake the sleeping pcb, or fail its send or recv if it has run out of time
+ */
+static void expire(pcb_t *pcb) {
+    if(pcb->blocked_status == BLOCKED_STATUS_SLEEP) {
+        wake(pcb);
         return;
     }
 
-    head->ret--;
-    while(head != NULL && head->ret <= 0) {
-        wake(head);
-        head = peek_pcb_from_sleep_queue();
+    cancel_timeout(pcb);
+    remove_pcb_from_blocked_queue(pcb);
+    pcb->blocked_id = 0;
+    pcb->ret = TIMEOUT;
+    add_pcb_to_ready_queue(pcb);
+}
+
+/*
+ * Empty the current slot of each level whose turn came up into the levels
+ * below, starting from the top
+ */
+static void cascade(void) {
+    for(int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        if((clock_ticks & ((1UL << (WHEEL_BITS * level)) - 1)) != 0) {
+            continue;
+        }
+
+        pcb_t **slot = &wheel[level][(clock_ticks >> (WHEEL_BITS * level)) & WHEEL_MASK];
+        pcb_t *pcb;
+        while((pcb = *slot) != NULL) {
+            wheel_unlink(pcb);
+            wheel_insert(pcb);
+        }
+    }
+}
+
+/*
+ * Number of clock ticks since the system started
+ */
+unsigned long get_clock_ticks(void) {
+    return clock_ticks;
+}
+
+/*
+ * Called when only the idle process can run. Instead of interrupting every
+ * clock tick, the timer is programmed to fire once on the tick the first
+ * sleeper wakes on, or as far ahead as the 16 bit counter allows.
+ * Returns the number of clock ticks the one-shot spans, or 0 if the periodic
+ * tick was kept because it would not save an interrupt, a real-time
+ * process needs every tick or a usleep sleeper is waiting.
+ */
+int tickless_enter(void) {
+    if(sched_rt_active() || hr_armed || pcb_peek(&hr_sleepers) != NULL) {
+        return 0;
+    }
+
+    // Counts left until the next periodic tick, which stays where it was
+    unsigned int first_tick = readPIT();
+    int max_ticks = 1 + (TIMER_MAX_COUNT - first_tick) / PIT_COUNTS_PER_TICK;
+    int ticks = ticks_to_next_slot(max_ticks);
+    if(ticks <= 1) {
+        return 0;
+    }
+
+    oneshot_first_tick = first_tick;
+    oneshot_ticks = ticks;
+    oneshot_counts = first_tick + (ticks - 1) * PIT_COUNTS_PER_TICK;
+    initPITOneShot(oneshot_counts);
+    return ticks;
+}
+
+/*
+ * Restore the periodic tick after tickless_enter. timer_fired is true if the
+ * kernel was entered by the one-shot itself, whose tick is then accounted by
+ * the timer interrupt as usual. If something else woke the kernel part way
+ * through a tick, the next tick is aimed at the rest of that tick, so the
+ * ticks keep their phase. Returns the number of clock ticks that passed
+ * without an interrupt, which the caller must still account.
+ */
+int tickless_exit(bool timer_fired) {
+    ASSERT(oneshot_counts != 0);
+    int skipped = oneshot_ticks - 1;
+    unsigned int to_tick = 0;
+
+    if(!timer_fired) {
+        // Once the one-shot expires the counter wraps, and its interrupt is still pending
+        unsigned int left = readPIT();
+        if(left <= oneshot_counts) {
+            unsigned int elapsed = oneshot_counts - left;
+            if(elapsed < oneshot_first_tick) {
+                skipped = 0;
+                to_tick = oneshot_first_tick - elapsed;
+            } else {
+                skipped = 1 + (elapsed - oneshot_first_tick) / PIT_COUNTS_PER_TICK;
+                to_tick = PIT_COUNTS_PER_TICK - (elapsed - oneshot_first_tick) % PIT_COUNTS_PER_TICK;
+            }
+        }
+    }
+
+    oneshot_counts = 0;
+    if(to_tick != 0) {
+        // Keep the phase of the ticks, the one-shot's interrupt restores the periodic tick
+        hrtimer_arm(to_tick, ~0U);
+    } else {
+        initPIT(CLOCK_TICKS_PER_SECOND);
     }
+    ticks_avoided += skipped;
+    return skipped;
 }
 
 /*
- * Wake sleeping processes and adds it to the ready queue
+ * Ticks until the first tick, at most max_ticks away, that wakes a sleeper
+ * or cascades sleepers from a higher level that might be due soon
+ */
+static int ticks_to_next_slot(int max_ticks) {
+    for(int ticks = 1; ticks < max_ticks; ticks++) {
+        unsigned long at = clock_ticks + ticks;
+        if((at & WHEEL_MASK) == 0 || wheel[0][at & WHEEL_MASK] != NULL) {
+            return ticks;
+        }
+    }
+    return max_ticks;
+}
+
+/*
+ * Number of clock ticks that passed without a timer interrupt
+ */
+long get_ticks_avoided(void) {
+    return ticks_avoided;
+}
+
+/*
+ * Wake sleeping processes and adds it to the ready queue. The sleep returns
+ * the milliseconds it had left, or the microseconds for usleep, 0 if it is
+ * due.
  */
 void wake(pcb_t *pcb) {
+    bool hires = pcb->queue == &hr_sleepers;
     remove_pcb_from_sleep_queue(pcb);
+    if(hires) {
+        unsigned long long now = clock_ns();
+        pcb->ret = pcb->wake_ns > now ? clock_ns_to_us(pcb->wake_ns - now) : 0;
+    } else {
+        pcb->ret = (pcb->wake_tick - clock_ticks) * MS_PER_CLOCK_TICK;
+    }
     add_pcb_to_ready_queue(pcb);
 }
 
 /*
- * Add the given pcb to the delta queue
+ * Put the sleeping pcb on the wheel, to wake on its wake_tick
  */
 void add_pcb_to_sleep_queue(pcb_t *entry) {
-    ASSERT(entry->next == NULL);
+    ASSERT(entry->queue == NULL && entry->timer_slot == NULL);
     entry->state = PROC_STATE_BLOCKED;
     entry->blocked_status = BLOCKED_STATUS_SLEEP;
-    pcb_t *prev = NULL;
-    pcb_t *curr = sleep_queue->head;
-    while(curr != NULL && curr->ret < entry->ret) {
-        entry->ret -= curr->ret;
-        prev = curr;
-        curr = curr->next;
-    }
+    wheel_insert(entry);
+}
 
-    if(curr == NULL) {
-        pcb_offer(sleep_queue, entry);
-        return;
+/*
+ * Add the pcb to the slot of the lowest level that reaches its wake tick.
+ * Wake ticks beyond the reach of the wheel go in the furthest slot of the
+ * top level, and come back to it when that slot cascades.
+ */
+static void wheel_insert(pcb_t *pcb) {
+    unsigned long wake_tick = pcb->wake_tick;
+    unsigned long ticks = wake_tick - clock_ticks;
+    if(ticks >= WHEEL_RANGE) {
+        wake_tick = clock_ticks + WHEEL_RANGE - 1;
+        ticks = WHEEL_RANGE - 1;
     }
 
-    curr->ret -= entry->ret;
-    entry->next = curr;
-    sleep_queue->size++;
-    if(prev == NULL) {
-        sleep_queue->head = entry;
-        return;
+    int level = 0;
+    while(ticks >= (1UL << (WHEEL_BITS * (level + 1)))) {
+        level++;
     }
+    wheel_link(&wheel[level][(wake_tick >> (WHEEL_BITS * level)) & WHEEL_MASK], pcb);
+}
 
-    prev->next = entry;
-    return;
+/*
+ * Add the pcb to the end of the slot
+ */
+static void wheel_link(pcb_t **slot, pcb_t *pcb) {
+    pcb_t *head = *slot;
+    if(head == NULL) {
+        pcb->timer_next = pcb;
+        pcb->timer_prev = pcb;
+        *slot = pcb;
+    } else {
+        pcb->timer_next = head;
+        pcb->timer_prev = head->timer_prev;
+        head->timer_prev->timer_next = pcb;
+        head->timer_prev = pcb;
+    }
+    pcb->timer_slot = slot;
 }
 
 /*
- * Remove the pcb from the sleep queue
+ * Remove the pcb from the slot it is in
  */
-bool remove_pcb_from_sleep_queue(pcb_t *pcb) {
-    return pcb_remove(sleep_queue, pcb);
+static void wheel_unlink(pcb_t *pcb) {
+    pcb_t **slot = pcb->timer_slot;
+    if(pcb->timer_next == pcb) {
+        *slot = NULL;
+    } else {
+        pcb->timer_prev->timer_next = pcb->timer_next;
+        pcb->timer_next->timer_prev = pcb->timer_prev;
+        if(*slot == pcb) {
+            *slot = pcb->timer_next;
+        }
+    }
+    pcb->timer_slot = NULL;
 }
 
 /*
- * Peeks the next pcb from sleep queue
+ * Remove the pcb from the wheel or the usleep list if it is sleeping
  */
-pcb_t *peek_pcb_from_sleep_queue(void) {
-    return pcb_peek(sleep_queue);
+bool remove_pcb_from_sleep_queue(pcb_t *pcb) {
+    if(pcb->state != PROC_STATE_BLOCKED || pcb->blocked_status != BLOCKED_STATUS_SLEEP) {
+        return FALSE;
+    }
+    if(pcb->timer_slot != NULL) {
+        wheel_unlink(pcb);
+        return TRUE;
+    }
+    return pcb->queue != NULL && pcb_remove(pcb->queue, pcb);
 }
 
 /*
- * Dumps the sleep queue to stdout
+ * Dumps the sleepers in every slot to stdout
  */
 void dump_sleep_queue(void) {
-    dump_pcb_queue(sleep_queue);
-} 
+    if(pcb_peek(&hr_sleepers) != NULL) {
+        kprintf("usleep:\n");
+        dump_pcb_queue(&hr_sleepers);
+    }
+    for(int level = 0; level < WHEEL_LEVELS; level++) {
+        for(int i = 0; i < WHEEL_SLOTS; i++) {
+            pcb_t *head = wheel[level][i];
+            if(head == NULL) {
+                continue;
+            }
+
+            kprintf("Level %d slot %d:", level, i);
+            pcb_t *pcb = head;
+            do {
+                kprintf(" %d (tick %d)", pcb->pid, pcb->wake_tick);
+                pcb = pcb->timer_next;
+            } while(pcb != head);
+            kprintf("\n");
+        }
+    }
+}
@@ -2,15 +2,31 @@
  * 
  * Called from other processes:
  *   syscreate() - Create a new process
+ *   syscreate_many() - Create a batch of processes running the same function
  *   sysyield()  - Pause execution of this process and allow another process to run
  *   sysstop()   - Stop the process 
  *   sysgetpid() - returns current process's pid
+ *   sysgetticks() - returns the clock ticks since the system started
  *   sysputs() - allows processes to perform synchronized output
  *   syssleep() - Put process to sleep for a number of milliseconds
+ *   sysusleep() - Put process to sleep for a number of microseconds
+ *   sysgettime_ns() - returns the nanoseconds since the system started
  *   syswait() - waits for a process to terminate
  *   sysgetcputimes() - Fills processStatuses struc with process cpu time info
  *   syssend() - sends data to a particular process
  *   sysrecv() - receives data delivered by syssend()
+ *   syssendtim() - syssend() that gives up after a number of milliseconds
+ *   sysrecvtim() - sysrecv() that gives up after a number of milliseconds
+ *   syssend_nb() - syssend() that fails instead of blocking
+ *   sysrecv_nb() - sysrecv() that fails instead of blocking
+ *   syssend_async() - sends through the receiver's mailbox without blocking
+ *   sysmailbox() - give the process a mailbox for syssend_async()
+ *   sysmailboxstats() - Fills mailboxStatuses struct with mailbox counters
+ *   sysregionalloc() - allocate a region of memory that can be sent without copying
+ *   sysregionfree() - free a region the process owns
+ *   syssend_region() - hands a region the process owns over to another process
+ *   syssendrecv() - sends a request and receives the reply in one call
+ *   sysreplywait() - replies to a client and receives the next request in one call
  *   syskill() - delivers a signal to a process
  *   syssighandler() - registers the handler as a signal handler
  *   syssigreturn() - restores a process's context after a signal is handled
@@ -19,34 +35,67 @@
  *   syswrite() - write to a file descriptor
  *   sysread() - read from a file descriptor
  *   sysioctl() - execute a device specific control command
+ *   syssetprio() - set the scheduling priority of a process
+ *   sysgetprio() - get the scheduling priority of a process
+ *   sysgetschedstats() - Fills schedStatuses struct with scheduler counters
+ *   syssettickets() - set the stride scheduling tickets of a process
+ *   syssetrt() - join or leave the earliest-deadline-first real-time class
+ *   syssetquantum() - set the time quantum of a process
+ *   sysringsetup() - register a ring to submit syscalls through in batches
+ *   sysringenter() - run every request submitted to the ring
 */
 
 #include <xeroskernel.h>
 #include <stdarg.h>
 
+static void copy_proc_row(processStatuses *ps, int slot, const volatile kernel_info_proc_t *row);
+
 /**
- * Executes the requested syscall given a request id. The return value is stored
- * in %eax and then returned in a variable. Additional syscall arguments are stored
- * in %edx.
+ * Executes the requested syscall given a request id and the number of
+ * arguments that follow. Enters the kernel with sysenter if contextinit()
+ * found the cpu supports it, otherwise through the SYSCALL_INT_NUM gate. The
+ * request id is passed in %eax and up to SYSCALL_MAX_ARGS arguments in %ebx,
+ * %ecx, %edx, %esi and %edi. Only nargs arguments are read, the registers
+ * past them are 0. The return value comes back in %eax.
  */
-int syscall(int req, ...) {
+int syscall(int req, int nargs, ...) {
+    unsigned long arg[SYSCALL_MAX_ARGS] = { 0 };
     va_list args;
     int result;
 
-    va_start(args, req);
+    ASSERT(nargs >= 0 && nargs <= SYSCALL_MAX_ARGS);
+    va_start(args, nargs);
+    for (int i = 0; i < nargs; i++) {
+        arg[i] = va_arg(args, unsigned long);
+    }
+    va_end(args);
+
+    if (syscall_entry == SYSCALL_ENTRY_SYSENTER) {
+        // sysenter saves nothing, so push the frame int would and hand over
+        // the stack in %ebp. The kernel returns to 1: with iret.
+        __asm__ volatile( " \
+            pushl %%ebp \n\
+            pushfl \n\
+            pushl %%cs \n\
+            pushl $1f \n\
+            movl %%esp, %%ebp \n\
+            sysenter \n\
+        1:  popl %%ebp \n"
+            : "=a" (result)
+            : "a" (req), "b" (arg[0]), "c" (arg[1]), "d" (arg[2]), "S" (arg[3]), "D" (arg[4])
+            : "memory"
+        );
+        return result;
+    }
 
     __asm__ volatile( " \
-        movl %1, %%eax \n\
-        movl %2, %%edx \n\
-        int %3  \n\
-        movl %%eax, %0 \n"
-        : "=r" (result)
-        : "r" (req), "r" (args), "i" (SYSCALL_INT_NUM)
-        : "%eax"
+        int %7  \n"
+        : "=a" (result)
+        : "a" (req), "b" (arg[0]), "c" (arg[1]), "d" (arg[2]), "S" (arg[3]), "D" (arg[4]),
+          "i" (SYSCALL_INT_NUM)
+        : "memory"
     );
 
-    va_end(args);
-
     return result;
 }
 
@@ -55,36 +104,56 @@ int syscall(int req, ...) {
  * and the stack size required
  */
 unsigned int syscreate(void (*func)(void), int stack) {
-    return (unsigned int)syscall(SYSCALL_CREATE,
+    return (unsigned int)syscall(SYSCALL_CREATE, 2,
                         (unsigned long)func, (unsigned long)stack);
 }
 
+/**
+ * Create n processes running func with the given stack size in one call,
+ * storing their pids in pids.
+ * Returns the number of processes created, fewer than n if creation failed
+ * part way, or a negative value if func or pids is invalid or n is not
+ * between 1 and PCB_TABLE_SIZE.
+ */
+int syscreate_many(void (*func)(void), int stack, int n, pid_t *pids) {
+    return syscall(SYSCALL_CREATEMANY, 4, (unsigned long)func,
+                   (unsigned long)stack, n, pids);
+}
+
 /**
  * Pause execution of this process
  */
 void sysyield(void) {
-    syscall(SYSCALL_YIELD);
+    syscall(SYSCALL_YIELD, 0);
 }
 
 /**
  * Stop this process
  */
 void sysstop(void) {
-    syscall(SYSCALL_STOP);
+    syscall(SYSCALL_STOP, 0);
 }
 
 /**
- * Return the PID of current process
+ * Return the PID of current process, read from the kernel info page
  */
 pid_t sysgetpid(void) {
-    return syscall(SYSCALL_GETPID);
+    return kernel_info->current_pid;
+}
+
+/**
+ * Return the number of clock ticks since the system started, read from the
+ * kernel info page
+ */
+unsigned long sysgetticks(void) {
+    return kernel_info->clock_ticks;
 }
 
 /**
  * Used by the process to perform synchronized output to the screen
  */
 void sysputs(char *str) {
-    syscall(SYSCALL_PUTS, str);
+    syscall(SYSCALL_PUTS, 1, str);
 }
 
 /**
@@ -93,36 +162,203 @@ void sysputs(char *str) {
  * A process can kill itself. Nothing is returned in that case.
  */
 int syskill(pid_t pid, int signalNumber) {
-    return syscall(SYSCALL_KILL, pid, signalNumber);
+    return syscall(SYSCALL_KILL, 2, pid, signalNumber);
 }
 
 /**
  * Sends a message to another process
  */
 int syssend(pid_t dest_pid, void *buffer, int buffer_len) {
-    return syscall(SYSCALL_SEND, dest_pid, buffer, buffer_len);
+    return syscall(SYSCALL_SEND, 3, dest_pid, buffer, buffer_len);
 }
 
 /**
  * Receives a message from another process
  */
 int sysrecv(pid_t *from_pid, void *buffer, int buffer_len) {
-    return syscall(SYSCALL_RECV, from_pid, buffer, buffer_len);
+    return syscall(SYSCALL_RECV, 3, from_pid, buffer, buffer_len);
+}
+
+/**
+ * Sends a message to another process, waiting at most the given milliseconds
+ * for it to be taken. A timeout of 0 only sends if the receiver is waiting.
+ * Returns the number of bytes sent, TIMEOUT if the time ran out, or the
+ * errors of syssend().
+ */
+int syssendtim(pid_t dest_pid, void *buffer, int buffer_len, unsigned int milliseconds) {
+    return syscall(SYSCALL_SENDTIM, 4, dest_pid, buffer, buffer_len, milliseconds);
+}
+
+/**
+ * Receives a message, waiting at most the given milliseconds for one to
+ * arrive. A timeout of 0 only receives if a sender is already waiting.
+ * Returns the number of bytes received, TIMEOUT if the time ran out, or the
+ * errors of sysrecv().
+ */
+int sysrecvtim(pid_t *from_pid, void *buffer, int buffer_len, unsigned int milliseconds) {
+    return syscall(SYSCALL_RECVTIM, 4, from_pid, buffer, buffer_len, milliseconds);
+}
+
+/**
+ * Sends a message to another process only if it is blocked receiving from
+ * the caller or from anyone. Never blocks.
+ * Returns the number of bytes sent, BLOCKERR if the receiver was not
+ * waiting, or the errors of syssend().
+ */
+int syssend_nb(pid_t dest_pid, void *buffer, int buffer_len) {
+    return syscall(SYSCALL_SENDNB, 3, dest_pid, buffer, buffer_len);
+}
+
+/**
+ * Receives a message only if a matching sender is already blocked sending
+ * to the caller. Never blocks.
+ * Returns the number of bytes received, BLOCKERR if no sender was waiting,
+ * or the errors of sysrecv().
+ */
+int sysrecv_nb(pid_t *from_pid, void *buffer, int buffer_len) {
+    return syscall(SYSCALL_RECVNB, 3, from_pid, buffer, buffer_len);
+}
+
+/**
+ * Sends a message of at most MAILBOX_MSG_MAX bytes without blocking. A
+ * receiver already waiting takes it directly, otherwise it is queued in the
+ * receiver's mailbox.
+ * Returns the number of bytes sent, BLOCKERR if the mailbox is full,
+ * SYSMAILBOX_NONE if the receiver has no mailbox, or the errors of syssend().
+ */
+int syssend_async(pid_t dest_pid, void *buffer, int buffer_len) {
+    return syscall(SYSCALL_SENDASYNC, 3, dest_pid, buffer, buffer_len);
+}
+
+/**
+ * Gives the calling process a mailbox of depth message slots, or takes it
+ * away if depth is 0. Queued messages that don't fit are dropped.
+ * Returns 0 on success, -2 if the depth is invalid, -4 if out of memory.
+ */
+int sysmailbox(int depth) {
+    return syscall(SYSCALL_MAILBOX, 1, depth);
+}
+
+/**
+ * Fills the mailboxStatuses struct with the counters of the caller's mailbox
+ * Returns 0 on success, -1 if the pointer is invalid, -6 if there is no mailbox
+ */
+int sysmailboxstats(mailboxStatuses *ms) {
+    return syscall(SYSCALL_MAILBOXSTATS, 1, ms);
+}
+
+/**
+ * Allocates a region of len bytes owned by the calling process. Only its
+ * owner may send or free it.
+ * Returns the start of the region, or NULL if out of memory or regions.
+ */
+void *sysregionalloc(int len) {
+    return (void *)syscall(SYSCALL_REGIONALLOC, 1, len);
+}
+
+/**
+ * Frees the region starting at base
+ * Returns 0 on success, -4 if the caller does not own such a region
+ */
+int sysregionfree(void *base) {
+    return syscall(SYSCALL_REGIONFREE, 1, base);
+}
+
+/**
+ * Sends the region starting at base like syssend() but without copying it.
+ * The receiver gets a region_t describing it, and owns it once it has
+ * received all of the region_t. The sender must no longer use the region.
+ * Returns the size of a region_t on success, -4 if the caller does not own
+ * such a region, or the errors of syssend().
+ */
+int syssend_region(pid_t dest_pid, void *base) {
+    return syscall(SYSCALL_SENDREGION, 2, dest_pid, base);
+}
+
+/**
+ * Sends a request to another process and waits for its reply, as a syssend()
+ * followed by a sysrecv() from the same process but with a single trap.
+ * Returns the length of the reply on success.
+ * Return -1 if the process does not exist or exits before replying,
+ * -2 if dest_pid is the caller, -3 otherwise.
+ */
+int syssendrecv(pid_t dest_pid, void *send_buffer, int send_len, void *recv_buffer, int recv_len) {
+    return syscall(SYSCALL_SENDRECV, 5, dest_pid, send_buffer, send_len, recv_buffer, recv_len);
+}
+
+/**
+ * Server side of syssendrecv(). Replies to the client in *client_pid, which
+ * must be waiting for a reply from the caller, then receives the next
+ * message from anyone and stores its sender in *client_pid. A client pid
+ * of 0 skips the reply. The reply never blocks.
+ * Returns the length of the received message on success.
+ * Return -1 if the client does not exist, -2 if it is the caller,
+ * -3 if the client is not waiting for a reply or on other errors.
+ */
+int sysreplywait(pid_t *client_pid, void *reply, int reply_len, void *buffer, int buffer_len) {
+    return syscall(SYSCALL_REPLYWAIT, 5, client_pid, reply, reply_len, buffer, buffer_len);
 }
 
 /**
  * Makes the process sleep for int milliseconds
+ * Returns 0, or the milliseconds left if a signal woke the process early
  */
 unsigned int syssleep(unsigned int milliseconds) {
-    return syscall(SYSCALL_SLEEP, milliseconds);
+    return syscall(SYSCALL_SLEEP, 1, milliseconds);
+}
+
+/**
+ * Makes the process sleep for int microseconds, without rounding up to a
+ * clock tick when the clock source has a finer resolution
+ * Returns 0, or the microseconds left if a signal woke the process early
+ */
+unsigned int sysusleep(unsigned int microseconds) {
+    return syscall(SYSCALL_USLEEP, 1, microseconds);
+}
+
+/**
+ * Stores the nanoseconds since the system started in ns
+ * Returns 0 on success, -1 if the pointer is invalid
+ */
+int sysgettime_ns(unsigned long long *ns) {
+    return syscall(SYSCALL_GETTIMENS, 1, ns);
 }
 
 /**
  * Populates the processStatuses struct with the amount of time each process
- * has been running for as well as it's current status.
+ * has been running for as well as it's current status. Copies the process
+ * table out of the kernel info page, and starts over if the kernel changed
+ * the page in the middle of the copy.
+ * Returns the last entry used in the table.
  */
 int sysgetcputimes(processStatuses *ps) {
-    return syscall(SYSCALL_CPUTIMES, ps);
+    unsigned long generation;
+    int slot;
+
+    do {
+        generation = kernel_info->generation;
+        slot = 0;
+        copy_proc_row(ps, slot, &kernel_info->idle);
+        for (int i = 0; i < PCB_TABLE_SIZE; i++) {
+            if (kernel_info->procs[i].status != PROC_STATE_STOPPED) {
+                copy_proc_row(ps, ++slot, &kernel_info->procs[i]);
+            }
+        }
+    } while (generation != kernel_info->generation);
+
+    return slot;
+}
+
+/**
+ * Copy a process row of the kernel info page into the given processStatuses slot
+ */
+static void copy_proc_row(processStatuses *ps, int slot, const volatile kernel_info_proc_t *row) {
+    ps->pid[slot] = row->pid;
+    ps->status[slot] = row->status;
+    ps->cpuTime[slot] = row->cpu_time * MS_PER_CLOCK_TICK;
+    ps->priority[slot] = row->priority;
+    ps->deadlineMisses[slot] = row->rt_misses;
+    ps->involuntarySwitches[slot] = row->involuntary_switches;
 }
 
 /**
@@ -130,7 +366,7 @@ int sysgetcputimes(processStatuses *ps) {
  * terminate. Return 0 if process terminated, -1 is the process DNE
  */
 int syswait(pid_t pid) {
-    return syscall(SYSCALL_WAIT, pid);
+    return syscall(SYSCALL_WAIT, 1, pid);
 }
 
 /**
@@ -142,7 +378,7 @@ int syswait(pid_t pid) {
  * If oldHandler address is invalid return -3
  */
 int syssighandler(int signal, funcptr_args newHandler, funcptr_args *oldHandler) {
-    return syscall(SYSCALL_SIGHANDLER, signal, newHandler, oldHandler);
+    return syscall(SYSCALL_SIGHANDLER, 3, signal, newHandler, oldHandler);
 }
 
 /**
@@ -150,7 +386,7 @@ int syssighandler(int signal, funcptr_args newHandler, funcptr_args *oldHandler)
  * Does not return. Used by the signal trampoline code.
  */
 void syssigreturn(void *old_sp) {
-    syscall(SYSCALL_SIGRETURN, old_sp);
+    syscall(SYSCALL_SIGRETURN, 1, old_sp);
     ASSERT(0); // This should never get here, so add an assertion
 }
 
@@ -159,7 +395,7 @@ void syssigreturn(void *old_sp) {
  * Return valid fd on success, -1 otherwise
  */
 int sysopen(int device_no) {
-    return syscall(SYSCALL_OPEN, device_no);
+    return syscall(SYSCALL_OPEN, 1, device_no);
 }
 
 /** 
@@ -167,7 +403,7 @@ int sysopen(int device_no) {
  * Return 0 on success, -1 otherwise
  */
 int sysclose(int fd) {
-    return syscall(SYSCALL_CLOSE, fd);
+    return syscall(SYSCALL_CLOSE, 1, fd);
 }
 
 /**
@@ -176,7 +412,7 @@ int sysclose(int fd) {
  * Return -1 on failure
  */
 int syswrite(int fd, void *buff, int bufflen) {
-    return syscall(SYSCALL_WRITE, fd, buff, bufflen);
+    return syscall(SYSCALL_WRITE, 3, fd, buff, bufflen);
 }
 
 /**
@@ -186,7 +422,7 @@ int syswrite(int fd, void *buff, int bufflen) {
  * Return -1 on failure.
  */
 int sysread(int fd, void *buff, int bufflen) {
-    return syscall(SYSCALL_READ, fd, buff, bufflen);
+    return syscall(SYSCALL_READ, 3, fd, buff, bufflen);
 }
 
 /**
@@ -198,10 +434,92 @@ int sysioctl(int fd, unsigned long command, ...) {
     va_list args;
 
     va_start(args, command);
-    result = syscall(SYSCALL_IOCTL, fd, command, args);
+    result = syscall(SYSCALL_IOCTL, 3, fd, command, args);
     va_end(args);
     
     return result;
 }
 
+/**
+ * Set the scheduling priority of the process with the given pid, or of the
+ * calling process if pid is 0. PRIORITY_HIGHEST is scheduled first.
+ * Returns the previous priority on success.
+ * Return -1 if the process does not exist, -2 if the priority is invalid.
+ */
+int syssetprio(pid_t pid, int priority) {
+    return syscall(SYSCALL_SETPRIO, 2, pid, priority);
+}
+
+/**
+ * Get the scheduling priority of the process with the given pid, or of the
+ * calling process if pid is 0.
+ * Return -1 if the process does not exist.
+ */
+int sysgetprio(pid_t pid) {
+    return syscall(SYSCALL_GETPRIO, 1, pid);
+}
+
+/**
+ * Populates the schedStatuses struct with the scheduler policy and its
+ * counters, such as the clock ticks spent running at each priority level.
+ * Return 0 on success, -1 if the struct address is invalid.
+ */
+int sysgetschedstats(schedStatuses *ss) {
+    return syscall(SYSCALL_SCHEDSTATS, 1, ss);
+}
+
+/**
+ * Set the number of stride scheduling tickets held by the process with the
+ * given pid, or by the calling process if pid is 0. Under the stride policy
+ * each process receives cpu time in proportion to its tickets.
+ * Returns the previous number of tickets on success.
+ * Return -1 if the process does not exist, -2 if tickets is not in 1..STRIDE_MAX_TICKETS.
+ */
+int syssettickets(pid_t pid, int tickets) {
+    return syscall(SYSCALL_SETTICKETS, 2, pid, tickets);
+}
+
+/**
+ * Move the calling process into the real-time class. Every period
+ * milliseconds a new job is released which may use budget milliseconds of
+ * cpu and should finish within deadline milliseconds (0 means the period).
+ * The job ends when the process calls sysyield() or uses its whole budget;
+ * it then waits for the next release. A period of 0 leaves the class.
+ * Return 0 on success, -2 if budget <= deadline <= period does not hold,
+ * -3 if admitting the process would exceed the cpu.
+ */
+int syssetrt(unsigned int period, unsigned int budget, unsigned int deadline) {
+    return syscall(SYSCALL_SETRT, 3, period, budget, deadline);
+}
 
+/**
+ * Set the number of clock ticks the process with the given pid, or the
+ * calling process if pid is 0, may run before the timer rotates to another
+ * ready process. The new quantum applies from the next time it is dispatched.
+ * Returns the previous quantum on success.
+ * Return -1 if the process does not exist, -2 if ticks is not in 1..QUANTUM_MAX_TICKS.
+ */
+int syssetquantum(pid_t pid, int ticks) {
+    return syscall(SYSCALL_SETQUANTUM, 2, pid, ticks);
+}
+
+/**
+ * Register the ring the process submits batches of syscalls through, or
+ * unregister it if ring is null. The kernel resets the ring's indices.
+ * Return 0 on success, -1 if the ring address is invalid.
+ */
+int sysringsetup(sysring_t *ring) {
+    return syscall(SYSCALL_RINGSETUP, 1, ring);
+}
+
+/**
+ * Run every request submitted to the registered ring in order, and post a
+ * completion with each result. A request that blocks holds up the rest of
+ * the batch until it completes. Requests that switch processes, such as
+ * yield, fail with -2 in their completion.
+ * Returns the number of requests run, fewer than submitted if the completion
+ * queue filled up, or -1 if no ring is registered.
+ */
+int sysringenter(void) {
+    return syscall(SYSCALL_RINGENTER, 0);
+}
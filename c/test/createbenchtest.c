@@ -0,0 +1,111 @@
+/* createbenchtest.c : process creation benchmarks
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+#define CREATE_BENCH_TICKS CLOCK_TICKS_PER_SECOND
+#define CREATE_BENCH_BATCH 8      /* Workers per syscreate_many call */
+
+static void root_test(void);
+static void create_bench_1(void);
+static void create_bench_2(void);
+static void create_bench_3(void);
+static void worker(void);
+static void handler(void *cntx);
+
+void run_create_bench_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    kprintf("Create benchmarks built with STACK_POOL_SIZE=%d\n", STACK_POOL_SIZE);
+    create_bench_1();
+    create_bench_2();
+    create_bench_3();
+
+    sysputs("Done all create benchmarks. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Processes created and waited for per second, one syscreate at a time.
+ * After the first exit every stack comes from the pool.
+ */
+void create_bench_1(void) {
+    long count = 0;
+    unsigned long cycles = 0;
+    unsigned long start_ticks = sysgetticks();
+
+    while (sysgetticks() - start_ticks < CREATE_BENCH_TICKS) {
+        unsigned long start = read_tsc();
+        pid_t pid = syscreate(worker, DEFAULT_STACK_SIZE);
+        ASSERT((int)pid > 0);
+        ASSERT_EQUAL(syswait(pid), 0);
+        cycles += read_tsc() - start;
+        count++;
+    }
+
+    kprintf("syscreate: %d create/exits per second, %d cycles each\n",
+            count * CLOCK_TICKS_PER_SECOND / CREATE_BENCH_TICKS, cycles / count);
+    kprintf("CREATE BENCH 1 FINISHED\n");
+}
+
+/**
+ * The same with batches of workers created in one trap by syscreate_many
+ */
+void create_bench_2(void) {
+    pid_t pids[CREATE_BENCH_BATCH];
+    long count = 0;
+    unsigned long cycles = 0;
+    unsigned long start_ticks = sysgetticks();
+
+    while (sysgetticks() - start_ticks < CREATE_BENCH_TICKS) {
+        unsigned long start = read_tsc();
+        ASSERT_EQUAL(syscreate_many(worker, DEFAULT_STACK_SIZE, CREATE_BENCH_BATCH, pids),
+                CREATE_BENCH_BATCH);
+        for (int i = 0; i < CREATE_BENCH_BATCH; i++) {
+            ASSERT_EQUAL(syswait(pids[i]), 0);
+        }
+        cycles += read_tsc() - start;
+        count += CREATE_BENCH_BATCH;
+    }
+
+    kprintf("syscreate_many: %d create/exits per second, %d cycles each\n",
+            count * CLOCK_TICKS_PER_SECOND / CREATE_BENCH_TICKS, cycles / count);
+    kprintf("CREATE BENCH 2 FINISHED\n");
+}
+
+/**
+ * A new process has no signal table until it sets a handler, and
+ * syscreate_many rejects bad arguments
+ */
+void create_bench_3(void) {
+    pid_t pids[CREATE_BENCH_BATCH];
+    funcptr_args old_handler = (funcptr_args)1;
+    pcb_t *pcb = pid_to_pcb(sysgetpid());
+
+    ASSERT_EQUAL(syscreate_many(worker, DEFAULT_STACK_SIZE, 0, pids), SYSERR);
+    ASSERT_EQUAL(syscreate_many(worker, DEFAULT_STACK_SIZE, 1, NULL), SYSERR);
+    ASSERT_EQUAL(syscreate_many(worker, DEFAULT_STACK_SIZE, PCB_TABLE_SIZE + 1, pids), SYSERR);
+    // The pid array size overflows to 4 bytes
+    ASSERT_EQUAL(syscreate_many(worker, DEFAULT_STACK_SIZE, 0x40000001, pids), SYSERR);
+
+    ASSERT_EQUAL(pcb->signal_table, NULL);
+    ASSERT_EQUAL(syssighandler(1, handler, &old_handler), 0);
+    ASSERT_EQUAL(old_handler, NULL);
+    ASSERT(pcb->signal_table != NULL);
+    ASSERT_EQUAL(syssighandler(1, NULL, &old_handler), 0);
+    ASSERT_EQUAL(old_handler, handler);
+    kprintf("CREATE BENCH 3 FINISHED\n");
+}
+
+/* Process created by root, exits right away */
+void worker(void) {
+}
+
+/* Signal handler installed by root, never called */
+void handler(void *cntx) {
+}
@@ -0,0 +1,140 @@
+/* hrtimertest.c : clock source and usleep tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define HRTIMER_READS 1000
+#define HRTIMER_SLEEP_MS 100
+#define HRTIMER_SAMPLES 20        /* Sleeps timed for each length */
+#define HRTIMER_LONG_US 5000000
+#define HRTIMER_SIGNAL 5
+
+static void root_test(void);
+static void hrtimer_test_1(void);
+static void hrtimer_test_2(void);
+static void hrtimer_test_3(void);
+static void measure_jitter(char *name, unsigned int us, bool ticks);
+static unsigned long elapsed_us(unsigned long long start);
+static void long_sleeper(void);
+static void handler(void *cntx);
+
+/* Requested sleeps, from well inside one tick to a few ticks */
+static const unsigned int sleep_us[] = { 50, 200, 1000, 3000, 7000, 25000 };
+
+static unsigned int sleep_left;
+
+void run_hrtimer_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    hrtimer_test_1();
+    hrtimer_test_2();
+    hrtimer_test_3();
+
+    sysputs("Done all hrtimer tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * The clock never goes backwards and keeps pace with the clock tick
+ */
+void hrtimer_test_1(void) {
+    unsigned long long prev, now;
+
+    ASSERT_EQUAL(sysgettime_ns(NULL), SYSERR);
+    ASSERT_EQUAL(sysgettime_ns(&prev), 0);
+    for (int i = 0; i < HRTIMER_READS; i++) {
+        ASSERT_EQUAL(sysgettime_ns(&now), 0);
+        ASSERT(now >= prev);
+        prev = now;
+    }
+
+    ASSERT_EQUAL(syssleep(HRTIMER_SLEEP_MS), 0);
+    unsigned long slept_ms = elapsed_us(prev) / 1000;
+    kprintf("syssleep(%d) took %d ms by the clock source\n", HRTIMER_SLEEP_MS, slept_ms);
+    ASSERT(slept_ms >= HRTIMER_SLEEP_MS - MS_PER_CLOCK_TICK);
+    ASSERT(slept_ms <= HRTIMER_SLEEP_MS + 2 * MS_PER_CLOCK_TICK);
+    kprintf("HRTIMER TEST 1 FINISHED\n");
+}
+
+/**
+ * Jitter benchmark: how late usleep wakes for each length, against syssleep
+ * which wakes on a clock tick. usleep never wakes early.
+ */
+void hrtimer_test_2(void) {
+    for (int i = 0; i < sizeof(sleep_us) / sizeof(sleep_us[0]); i++) {
+        measure_jitter("usleep", sleep_us[i], FALSE);
+    }
+    for (int i = 0; i < sizeof(sleep_us) / sizeof(sleep_us[0]); i++) {
+        if (sleep_us[i] >= 1000) {
+            measure_jitter("sleep", sleep_us[i], TRUE);
+        }
+    }
+    kprintf("HRTIMER TEST 2 FINISHED\n");
+}
+
+/**
+ * A usleep cut short by a signal returns the microseconds left
+ */
+void hrtimer_test_3(void) {
+    pid_t pid = syscreate(long_sleeper, DEFAULT_STACK_SIZE);
+    syssleep(10 * MS_PER_CLOCK_TICK);
+    ASSERT_EQUAL(syskill(pid, HRTIMER_SIGNAL), 0);
+    syswait(pid);
+    kprintf("Interrupted usleep returned %d us left\n", sleep_left);
+    ASSERT(sleep_left > 0 && sleep_left < HRTIMER_LONG_US);
+    kprintf("HRTIMER TEST 3 FINISHED\n");
+}
+
+/**
+ * Sleep HRTIMER_SAMPLES times for us microseconds, with syssleep rounded to
+ * milliseconds if ticks is set, and print how late the wakeups were
+ */
+static void measure_jitter(char *name, unsigned int us, bool ticks) {
+    unsigned long min_late = ~0UL;
+    unsigned long max_late = 0;
+    unsigned long total_late = 0;
+
+    for (int i = 0; i < HRTIMER_SAMPLES; i++) {
+        unsigned long long start;
+        sysgettime_ns(&start);
+        if (ticks) {
+            ASSERT_EQUAL(syssleep(us / 1000), 0);
+        } else {
+            ASSERT_EQUAL(sysusleep(us), 0);
+        }
+        unsigned long slept = elapsed_us(start);
+
+        ASSERT(ticks || slept >= us);
+        unsigned long late = slept > us ? slept - us : 0;
+        min_late = late < min_late ? late : min_late;
+        max_late = late > max_late ? late : max_late;
+        total_late += late;
+    }
+
+    kprintf("%s %d us: late by min %d, avg %d, max %d us\n", name, us,
+            min_late, total_late / HRTIMER_SAMPLES, max_late);
+}
+
+/**
+ * Microseconds since start, a sysgettime_ns() reading
+ */
+static unsigned long elapsed_us(unsigned long long start) {
+    unsigned long long now;
+    sysgettime_ns(&now);
+    return (unsigned long)(now - start) / 1000;
+}
+
+/* Process created by root, sleeps until root signals it */
+void long_sleeper(void) {
+    funcptr_args old_handler;
+    ASSERT_EQUAL(syssighandler(HRTIMER_SIGNAL, handler, &old_handler), 0);
+    sleep_left = sysusleep(HRTIMER_LONG_US);
+}
+
+/* Signal handler of long_sleeper */
+void handler(void *cntx) {
+}
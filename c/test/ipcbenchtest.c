@@ -0,0 +1,104 @@
+/* ipcbenchtest.c : message passing benchmarks
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+#define IPC_BENCH_ROUND_TRIPS 1000
+#define IPC_BENCH_STEP 4          /* Blocked processes added between measurements */
+#define IPC_BENCH_MSG_LEN 16
+
+static void root_test(void);
+static void ipc_bench_1(void);
+static void echo_server(void);
+static void blocked_receiver(void);
+static unsigned long round_trip_cycles(pid_t server);
+
+static pid_t bench_root_pid;
+
+void run_ipc_bench_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    bench_root_pid = sysgetpid();
+    ipc_bench_1();
+
+    sysputs("Done all ipc benchmarks. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Send/recv round trip latency to an echo server while more and more
+ * processes sit blocked receiving from the root, up to the pcb table limit.
+ * The cost per round trip should stay flat as the blocked count grows.
+ */
+void ipc_bench_1(void) {
+    pid_t blocked[PCB_TABLE_SIZE];
+    int num_blocked = 0;
+    bool table_full = FALSE;
+
+    pid_t server = syscreate(echo_server, DEFAULT_STACK_SIZE);
+    ASSERT((int)server > 0);
+
+    while(!table_full) {
+        unsigned long cycles = round_trip_cycles(server);
+        kprintf("%d blocked: %d cycles per send/recv round trip\n", num_blocked, cycles);
+
+        for (int i = 0; i < IPC_BENCH_STEP; i++) {
+            pid_t pid = syscreate(blocked_receiver, DEFAULT_STACK_SIZE);
+            if ((int)pid <= 0) {
+                table_full = TRUE;
+                break;
+            }
+            blocked[num_blocked++] = pid;
+        }
+
+        // Let the new processes run until they block
+        syssleep(MS_PER_CLOCK_TICK);
+    }
+
+    for (int i = 0; i < num_blocked; i++) {
+        syskill(blocked[i], KILL_SIGNAL_NUM);
+    }
+    syskill(server, KILL_SIGNAL_NUM);
+    kprintf("IPC BENCH 1 FINISHED\n");
+}
+
+/**
+ * Average cycles for the root to send a message to the server and receive
+ * the echo, over IPC_BENCH_ROUND_TRIPS round trips
+ */
+static unsigned long round_trip_cycles(pid_t server) {
+    char msg[IPC_BENCH_MSG_LEN] = "ping";
+    char reply[IPC_BENCH_MSG_LEN];
+
+    unsigned long start = read_tsc();
+    for (int i = 0; i < IPC_BENCH_ROUND_TRIPS; i++) {
+        pid_t from = server;
+        ASSERT_EQUAL(syssend(server, msg, sizeof(msg)), sizeof(msg));
+        ASSERT_EQUAL(sysrecv(&from, reply, sizeof(reply)), sizeof(reply));
+    }
+    return (read_tsc() - start) / IPC_BENCH_ROUND_TRIPS;
+}
+
+/* Process created by root, returns every message to its sender */
+void echo_server(void) {
+    char buffer[IPC_BENCH_MSG_LEN];
+    for(;;) {
+        pid_t from = 0;
+        int len = sysrecv(&from, buffer, sizeof(buffer));
+        if (len > 0) {
+            syssend(from, buffer, len);
+        }
+    }
+}
+
+/* Process created by root, blocks receiving from the root until killed */
+void blocked_receiver(void) {
+    char buffer[IPC_BENCH_MSG_LEN];
+    pid_t from = bench_root_pid;
+    sysrecv(&from, buffer, sizeof(buffer));
+}
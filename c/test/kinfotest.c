@@ -0,0 +1,95 @@
+/* kinfotest.c : kernel info page tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define KINFO_MONITOR_ROUNDS 1000
+
+static void root_test(void);
+static void kinfo_test_1(void);
+static void kinfo_test_2(void);
+static void sleeper(void);
+
+void run_kinfo_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    kinfo_test_1();
+    kinfo_test_2();
+
+    sysputs("Done all kernel info tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * The page agrees with what the syscalls report through a trap
+ */
+void kinfo_test_1(void) {
+    processStatuses page_ps;
+    processStatuses trap_ps;
+
+    pid_t child = syscreate(sleeper, DEFAULT_STACK_SIZE);
+    syssleep(MS_PER_CLOCK_TICK);
+
+    ASSERT_EQUAL(sysgetpid(), syscall(SYSCALL_GETPID, 0));
+
+    int page_num = sysgetcputimes(&page_ps);
+    int trap_num = syscall(SYSCALL_CPUTIMES, 1, &trap_ps);
+    ASSERT_EQUAL(page_num, trap_num);
+    for (int i = 0; i <= page_num; i++) {
+        ASSERT_EQUAL(page_ps.pid[i], trap_ps.pid[i]);
+        ASSERT_EQUAL(page_ps.status[i], trap_ps.status[i]);
+        ASSERT_EQUAL(page_ps.priority[i], trap_ps.priority[i]);
+        if (page_ps.pid[i] == child) {
+            ASSERT_EQUAL(page_ps.status[i], PROC_STATE_BLOCKED + BLOCKED_STATUS_SLEEP);
+        }
+    }
+
+    unsigned long ticks = sysgetticks();
+    syssleep(MS_PER_CLOCK_TICK * 2);
+    ASSERT(sysgetticks() >= ticks + 2);
+
+    syskill(child, KILL_SIGNAL_NUM);
+    kprintf("KINFO TEST 1 FINISHED\n");
+}
+
+/**
+ * A monitoring loop that polls its pid, the clock and the process table.
+ * Reading the page enters the kernel only when the timer does, trapping
+ * enters it three times a round.
+ */
+void kinfo_test_2(void) {
+    processStatuses ps;
+
+    unsigned long generation = kernel_info->generation;
+    for (int i = 0; i < KINFO_MONITOR_ROUNDS; i++) {
+        sysgetpid();
+        sysgetticks();
+        sysgetcputimes(&ps);
+    }
+    long page_entries = kernel_info->generation - generation;
+
+    generation = kernel_info->generation;
+    for (int i = 0; i < KINFO_MONITOR_ROUNDS; i++) {
+        syscall(SYSCALL_GETPID, 0);
+        syscall(SYSCALL_GETPID, 0);
+        syscall(SYSCALL_CPUTIMES, 1, &ps);
+    }
+    long trap_entries = kernel_info->generation - generation;
+
+    kprintf("%d monitor rounds: %d kernel entries reading the page, %d trapping\n",
+            KINFO_MONITOR_ROUNDS, page_entries, trap_entries);
+    ASSERT(trap_entries >= KINFO_MONITOR_ROUNDS * 3);
+    ASSERT(page_entries < trap_entries);
+    kprintf("KINFO TEST 2 FINISHED\n");
+}
+
+/* Process created by root, sleeps until killed */
+void sleeper(void) {
+    for(;;) {
+        syssleep(1000);
+    }
+}
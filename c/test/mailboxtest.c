@@ -0,0 +1,150 @@
+/* mailboxtest.c : asynchronous mailbox tests and benchmarks
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define MAILBOX_TEST_DEPTH 4
+#define MAILBOX_TEST_BURST 6      /* Sends into a full mailbox, two more than fit */
+#define MAILBOX_BENCH_MSGS 20000
+#define MAILBOX_BENCH_MSG_LEN 16
+
+static void root_test(void);
+static void mailbox_test_1(void);
+static void mailbox_test_2(void);
+static unsigned long bench(int depth);
+static void burst_producer(void);
+static void producer(void);
+
+/* Depths of the asynchronous runs of the benchmark */
+static const int bench_depths[] = { 1, 16, 64, MAILBOX_MAX_DEPTH };
+
+static pid_t consumer_pid;
+static int burst_results[MAILBOX_TEST_BURST];
+static bool bench_async;
+
+void run_mailbox_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    consumer_pid = sysgetpid();
+    mailbox_test_1();
+    mailbox_test_2();
+
+    sysputs("Done all mailbox tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * A producer fills the mailbox without blocking and is refused once it is
+ * full. Shrinking the mailbox drops the newest messages, and recv takes the
+ * rest in order.
+ */
+void mailbox_test_1(void) {
+    mailboxStatuses ms;
+
+    ASSERT_EQUAL(sysmailboxstats(&ms), SYSMAILBOX_NONE);
+    ASSERT_EQUAL(sysmailbox(-1), SYSMAILBOX_INVALID);
+    ASSERT_EQUAL(sysmailbox(MAILBOX_MAX_DEPTH + 1), SYSMAILBOX_INVALID);
+    ASSERT_EQUAL(sysmailbox(MAILBOX_TEST_DEPTH), 0);
+
+    pid_t pid = syscreate(burst_producer, DEFAULT_STACK_SIZE);
+    syswait(pid);
+    for (int i = 0; i < MAILBOX_TEST_BURST; i++) {
+        int expected = i < MAILBOX_TEST_DEPTH ? sizeof(int) : BLOCKERR;
+        ASSERT_EQUAL(burst_results[i], expected);
+    }
+
+    ASSERT_EQUAL(sysmailboxstats(&ms), 0);
+    ASSERT_EQUAL(ms.depth, MAILBOX_TEST_DEPTH);
+    ASSERT_EQUAL(ms.queued, MAILBOX_TEST_DEPTH);
+    ASSERT_EQUAL(ms.maxQueued, MAILBOX_TEST_DEPTH);
+    ASSERT_EQUAL(ms.rejected, MAILBOX_TEST_BURST - MAILBOX_TEST_DEPTH);
+
+    ASSERT_EQUAL(sysmailbox(2), 0);
+    ASSERT_EQUAL(sysmailboxstats(&ms), 0);
+    ASSERT_EQUAL(ms.queued, 2);
+    ASSERT_EQUAL(ms.dropped, MAILBOX_TEST_DEPTH - 2);
+    ASSERT_EQUAL(ms.maxQueued, MAILBOX_TEST_DEPTH);
+
+    for (int i = 0; i < 2; i++) {
+        int msg;
+        pid_t from = 0;
+        ASSERT_EQUAL(sysrecv(&from, &msg, sizeof(msg)), sizeof(msg));
+        ASSERT_EQUAL(from, pid);
+        ASSERT_EQUAL(msg, i);
+    }
+    pid_t from = 0;
+    int msg;
+    ASSERT_EQUAL(sysrecv_nb(&from, &msg, sizeof(msg)), BLOCKERR);
+
+    ASSERT_EQUAL(sysmailboxstats(&ms), 0);
+    ASSERT_EQUAL(ms.delivered, 2);
+    ASSERT_EQUAL(sysmailbox(0), 0);
+    ASSERT_EQUAL(sysmailboxstats(&ms), SYSMAILBOX_NONE);
+    kprintf("MAILBOX TEST 1 FINISHED\n");
+}
+
+/**
+ * Producer/consumer throughput, rendezvous against mailboxes of growing
+ * depth. With a mailbox the producer only gives up the cpu once it is full.
+ */
+void mailbox_test_2(void) {
+    kprintf("rendezvous: %d cycles per message\n", bench(0));
+
+    for (int i = 0; i < sizeof(bench_depths) / sizeof(bench_depths[0]); i++) {
+        mailboxStatuses ms;
+        ASSERT_EQUAL(sysmailbox(bench_depths[i]), 0);
+        unsigned long cycles = bench(bench_depths[i]);
+        ASSERT_EQUAL(sysmailboxstats(&ms), 0);
+        kprintf("async depth %d: %d cycles per message, %d through the mailbox, "
+                "%d queued at most, %d sends refused\n",
+                bench_depths[i], cycles, ms.delivered, ms.maxQueued, ms.rejected);
+        ASSERT(ms.delivered <= MAILBOX_BENCH_MSGS);
+        ASSERT_EQUAL(sysmailbox(0), 0);
+    }
+    kprintf("MAILBOX TEST 2 FINISHED\n");
+}
+
+/**
+ * Receive MAILBOX_BENCH_MSGS messages from a producer, sending with
+ * syssend_async if depth is not 0 and with syssend otherwise.
+ * Returns the average cycles per message.
+ */
+static unsigned long bench(int depth) {
+    char msg[MAILBOX_BENCH_MSG_LEN];
+
+    bench_async = depth != 0;
+    unsigned long start = read_tsc();
+    pid_t pid = syscreate(producer, DEFAULT_STACK_SIZE);
+    for (int i = 0; i < MAILBOX_BENCH_MSGS; i++) {
+        pid_t from = pid;
+        ASSERT_EQUAL(sysrecv(&from, msg, sizeof(msg)), sizeof(msg));
+    }
+    unsigned long cycles = read_tsc() - start;
+    syswait(pid);
+    return cycles / MAILBOX_BENCH_MSGS;
+}
+
+/* Process created by root, sends more messages than its mailbox holds */
+void burst_producer(void) {
+    for (int i = 0; i < MAILBOX_TEST_BURST; i++) {
+        burst_results[i] = syssend_async(consumer_pid, &i, sizeof(i));
+    }
+}
+
+/* Process created by root, sends it MAILBOX_BENCH_MSGS messages */
+void producer(void) {
+    char msg[MAILBOX_BENCH_MSG_LEN] = "produced";
+    for (int i = 0; i < MAILBOX_BENCH_MSGS; i++) {
+        if (!bench_async) {
+            syssend(consumer_pid, msg, sizeof(msg));
+            continue;
+        }
+        while (syssend_async(consumer_pid, msg, sizeof(msg)) == BLOCKERR) {
+            sysyield();
+        }
+    }
+}
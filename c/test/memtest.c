@@ -2,6 +2,7 @@
 
 #include <kerneltest.h>
 #include <xeroskernel.h>
+#include <xeroslib.h>
 #include <i386.h>
 
 extern long freemem;
@@ -9,10 +10,28 @@ extern char *maxaddr;
 
 static void mem_test_1(void);
 static void mem_test_2(void);
+static void mem_test_3(void);
+static void mem_test_4(void);
+static void mem_test_5(void);
+static void mem_test_6(void);
+static void mem_test_7(void);
+static unsigned long create_exit_cycles(void);
+
+#define MEM_TIMING_SLOTS 64
+#define MEM_TIMING_ROUNDS 4000
+#define MEM_FRAG_PINS 96          /* Allocations left pinned between freed holes */
+#define MEM_FRAG_STEP 16
+#define MEM_CACHE_OBJS 300        /* Enough objects to need several slabs */
+#define MEM_PAGE_HOLD 32
 
 void run_mem_tests(void) {
     mem_test_1();
     mem_test_2();
+    mem_test_3();
+    mem_test_4();
+    mem_test_5();
+    mem_test_6();
+    mem_test_7();
     for(;;);
 }
 
@@ -64,3 +83,176 @@ void mem_test_2(void) {
     mem_dump();
     kprintf("MEM_TEST_2 FINISHED\n");
 }
+
+/**
+ * Average cycles per kfree/kmalloc pair while churning a mix of the sizes
+ * the kernel allocates: pcb queues, signal tables, idle and process stacks
+ */
+void mem_test_3(void) {
+    static const int sizes[] = { 16, 128, 256, 2048, 4800, 8192 };
+    int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    void *slots[MEM_TIMING_SLOTS];
+
+    for(int i = 0; i < MEM_TIMING_SLOTS; i++) {
+        slots[i] = kmalloc(sizes[i % num_sizes]);
+        ASSERT(slots[i] != 0);
+    }
+
+    unsigned long start = read_tsc();
+    for(int i = 0; i < MEM_TIMING_ROUNDS; i++) {
+        // Step through the slots and sizes at different rates to mix them up
+        int slot = (i * 7) % MEM_TIMING_SLOTS;
+        ASSERT_EQUAL(kfree(slots[slot]), 1);
+        slots[slot] = kmalloc(sizes[i % num_sizes]);
+        ASSERT(slots[slot] != 0);
+    }
+    unsigned long cycles = (read_tsc() - start) / MEM_TIMING_ROUNDS;
+
+    for(int i = 0; i < MEM_TIMING_SLOTS; i++) {
+        ASSERT_EQUAL(kfree(slots[i]), 1);
+    }
+    ASSERT_EQUAL(kfree(slots[0]), 0);
+
+    mem_dump();
+    kprintf("%d cycles per kfree/kmalloc pair over mixed sizes\n", cycles);
+    kprintf("MEM_TEST_3 FINISHED\n");
+}
+
+/**
+ * Cycles for the allocations of a process create and exit as the heap gets
+ * more fragmented. Pinned signal table sized chunks between freed stacks
+ * leave holes that can't merge, the cost should stay flat regardless.
+ */
+void mem_test_4(void) {
+    void *stacks[MEM_FRAG_PINS];
+    void *pins[MEM_FRAG_PINS];
+
+    for(int i = 0; i < MEM_FRAG_PINS; i++) {
+        stacks[i] = kmalloc(DEFAULT_STACK_SIZE / 2);
+        pins[i] = kmalloc(SIGNAL_TABLE_SIZE * sizeof(funcptr_args));
+        ASSERT(stacks[i] != 0 && pins[i] != 0);
+    }
+
+    for(int i = 0; i <= MEM_FRAG_PINS; i += MEM_FRAG_STEP) {
+        kprintf("%d holes: %d cycles per create/exit\n", i, create_exit_cycles());
+        for(int j = i; j < i + MEM_FRAG_STEP && j < MEM_FRAG_PINS; j++) {
+            ASSERT_EQUAL(kfree(stacks[j]), 1);
+        }
+    }
+
+    for(int i = 0; i < MEM_FRAG_PINS; i++) {
+        ASSERT_EQUAL(kfree(pins[i]), 1);
+    }
+    mem_dump();
+    kprintf("MEM_TEST_4 FINISHED\n");
+}
+
+/**
+ * Average cycles to allocate and free a process stack and signal table
+ */
+static unsigned long create_exit_cycles(void) {
+    unsigned long start = read_tsc();
+    for(int i = 0; i < MEM_TIMING_ROUNDS; i++) {
+        void *stack = kmalloc(DEFAULT_STACK_SIZE);
+        funcptr_args *signal_table = alloc_signal_table();
+        ASSERT(stack != 0 && signal_table != 0);
+        free_signal_table(signal_table);
+        kfree(stack);
+    }
+    return (read_tsc() - start) / MEM_TIMING_ROUNDS;
+}
+
+/**
+ * Objects from a cache are distinct, aligned and reused once freed
+ */
+void mem_test_5(void) {
+    static void *objs[MEM_CACHE_OBJS];
+    kmem_cache_t *cache = kmem_cache_create("test", 24, 32);
+    ASSERT(cache != NULL);
+
+    for(int i = 0; i < MEM_CACHE_OBJS; i++) {
+        objs[i] = kmem_cache_alloc(cache);
+        ASSERT(objs[i] != NULL);
+        ASSERT_EQUAL((unsigned long)objs[i] % 32, 0);
+        memset(objs[i], i, 24);
+    }
+    for(int i = 0; i < MEM_CACHE_OBJS; i++) {
+        ASSERT_EQUAL(*(unsigned char *)objs[i], (unsigned char)i);
+    }
+
+    void *last = objs[MEM_CACHE_OBJS - 1];
+    for(int i = 0; i < MEM_CACHE_OBJS; i++) {
+        kmem_cache_free(cache, objs[i]);
+    }
+    ASSERT_EQUAL(kmem_cache_alloc(cache), last);
+    kmem_cache_free(cache, last);
+
+    unsigned long start = read_tsc();
+    for(int i = 0; i < MEM_TIMING_ROUNDS; i++) {
+        kmem_cache_free(cache, kmem_cache_alloc(cache));
+    }
+    kprintf("%d cycles per cache alloc/free\n", (read_tsc() - start) / MEM_TIMING_ROUNDS);
+
+    mem_dump();
+    kprintf("MEM_TEST_5 FINISHED\n");
+}
+
+/**
+ * Page blocks are aligned to their size and never in the hole, and a split
+ * block hands out its two halves as buddies
+ */
+void mem_test_6(void) {
+    void *held[MEM_PAGE_HOLD];
+    int num_held = 0;
+
+    ASSERT_EQUAL(kpage_order(1), 0);
+    ASSERT_EQUAL(kpage_order(NBPG), 0);
+    ASSERT_EQUAL(kpage_order(NBPG + 1), 1);
+    ASSERT_EQUAL(kpage_order(DEFAULT_STACK_SIZE), 1);
+    ASSERT_EQUAL(kpage_alloc(-1), NULL);
+
+    for(int order = 0; order < 4; order++) {
+        void *block = kpage_alloc(order);
+        ASSERT(block != NULL);
+        ASSERT_EQUAL((unsigned long)block % (NBPG << order), 0);
+        ASSERT(verify_sysptr(block, NBPG << order) == OK);
+        held[num_held++] = block;
+    }
+
+    // Once the free order 3 blocks run out, the next two come from one split
+    void *low = kpage_alloc(3);
+    void *high = kpage_alloc(3);
+    while(((unsigned long)low ^ (unsigned long)high) != (NBPG << 3)) {
+        ASSERT(num_held < MEM_PAGE_HOLD);
+        held[num_held++] = low;
+        low = high;
+        high = kpage_alloc(3);
+        ASSERT(high != NULL);
+    }
+    ASSERT_EQUAL(kpage_free(low), 1);
+    ASSERT_EQUAL(kpage_free(high), 1);
+    ASSERT_EQUAL(kpage_free(high), 0);
+
+    for(int i = 0; i < num_held; i++) {
+        ASSERT_EQUAL(kpage_free(held[i]), 1);
+    }
+    mem_dump();
+    kprintf("MEM_TEST_6 FINISHED\n");
+}
+
+/**
+ * Freeing a chunk again fails after it merged into the free chunk before it
+ */
+void mem_test_7(void) {
+    void *a = kmalloc(100);
+    void *b = kmalloc(100);
+    void *pin = kmalloc(100);     // Keeps b from merging forward
+    ASSERT(a != 0 && b != 0 && pin != 0);
+
+    ASSERT_EQUAL(kfree(a), 1);
+    ASSERT_EQUAL(kfree(b), 1);
+    ASSERT_EQUAL(kfree(b), 0);
+    ASSERT_EQUAL(kfree(a), 0);
+    ASSERT_EQUAL(kfree(pin), 1);
+    kprintf("MEM_TEST_7 FINISHED\n");
+}
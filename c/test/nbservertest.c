@@ -0,0 +1,125 @@
+/* nbservertest.c : non-blocking send and recv tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define NB_CLIENTS 30             /* With the root, one short of a full pcb table */
+#define NB_REQUESTS 10            /* Requests each client makes */
+
+static void root_test(void);
+static void nb_test_1(void);
+static void nb_test_2(void);
+static void client(void);
+static void idle_sleeper(void);
+
+static pid_t server_pid;
+static int clients_done;
+static int client_errors;
+
+void run_nb_server_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    server_pid = sysgetpid();
+    nb_test_1();
+    nb_test_2();
+
+    sysputs("Done all non-blocking tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Without a partner waiting, syssend_nb and sysrecv_nb return BLOCKERR and
+ * leave nothing queued behind
+ */
+void nb_test_1(void) {
+    int msg = 0;
+    pid_t from = 0;
+
+    ASSERT_EQUAL(sysrecv_nb(&from, &msg, sizeof(msg)), BLOCKERR);
+
+    pid_t sleeper = syscreate(idle_sleeper, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssend_nb(sleeper, &msg, sizeof(msg)), BLOCKERR);
+    ASSERT_EQUAL(syskill(sleeper, KILL_SIGNAL_NUM), 0);
+    syswait(sleeper);
+    kprintf("NB TEST 1 FINISHED\n");
+}
+
+/**
+ * A single process serves NB_CLIENTS clients at once. It takes whichever
+ * request is waiting and holds each reply until its client is receiving,
+ * yielding only when neither makes progress.
+ */
+void nb_test_2(void) {
+    pid_t pending[NB_CLIENTS];   /* Clients whose reply is not yet taken */
+    int replies[NB_CLIENTS];
+    int num_pending = 0;
+    int served = 0;
+    int polls = 0;
+
+    clients_done = 0;
+    client_errors = 0;
+    for (int i = 0; i < NB_CLIENTS; i++) {
+        ASSERT((int)syscreate(client, DEFAULT_STACK_SIZE) > 0);
+    }
+
+    while (served < NB_CLIENTS * NB_REQUESTS) {
+        bool progress = FALSE;
+        polls++;
+
+        int request;
+        pid_t from = 0;
+        if (sysrecv_nb(&from, &request, sizeof(request)) == sizeof(request)) {
+            ASSERT(num_pending < NB_CLIENTS);
+            pending[num_pending] = from;
+            replies[num_pending] = request + 1;
+            num_pending++;
+            progress = TRUE;
+        }
+
+        for (int i = 0; i < num_pending; i++) {
+            if (syssend_nb(pending[i], &replies[i], sizeof(replies[i])) == sizeof(replies[i])) {
+                num_pending--;
+                pending[i] = pending[num_pending];
+                replies[i] = replies[num_pending];
+                i--;
+                served++;
+                progress = TRUE;
+            }
+        }
+
+        if (!progress) {
+            sysyield();
+        }
+    }
+
+    while (clients_done < NB_CLIENTS) {
+        sysyield();
+    }
+    kprintf("Served %d requests from %d clients in %d polls\n", served, NB_CLIENTS, polls);
+    ASSERT_EQUAL(client_errors, 0);
+    kprintf("NB TEST 2 FINISHED\n");
+}
+
+/* Process created by root, makes blocking requests to the server */
+void client(void) {
+    for (int i = 0; i < NB_REQUESTS; i++) {
+        int request = sysgetpid() * NB_REQUESTS + i;
+        int reply;
+        pid_t from = server_pid;
+        if (syssend(server_pid, &request, sizeof(request)) != sizeof(request)
+                || sysrecv(&from, &reply, sizeof(reply)) != sizeof(reply)
+                || reply != request + 1) {
+            client_errors++;
+        }
+    }
+    clients_done++;
+}
+
+/* Process created by root, never receives */
+void idle_sleeper(void) {
+    syssleep(1000 * MS_PER_CLOCK_TICK);
+}
@@ -9,12 +9,14 @@ static void queue_test_1(void);
 static void queue_test_2(void);
 static void queue_test_3(void);
 static void queue_test_4(void);
+static void queue_test_5(void);
 
 void run_queue_tests(void) {
     queue_test_1();
     queue_test_2();
     queue_test_3();
     queue_test_4();
+    queue_test_5();
     for(;;);
 }
 
@@ -32,7 +34,7 @@ void queue_test_1(void) {
     ASSERT_EQUAL(size, 0);
     ASSERT_EQUAL(result, entry);
     kfree(entry);
-    kfree(queue);
+    free_pcb_queue(queue);
     kprintf("QUEUE_TEST_1 FINISHED\n");
 }
 
@@ -54,7 +56,7 @@ void queue_test_2(void) {
 
     size = pcb_size(queue);
     ASSERT_EQUAL(size, 0);
-    kfree(queue);
+    free_pcb_queue(queue);
     kprintf("QUEUE_TEST_2 FINISHED\n");
 }
 
@@ -80,7 +82,7 @@ void queue_test_3(void) {
     }
 
     dump_pcb_queue(queue);
-    kfree(queue);
+    free_pcb_queue(queue);
     kprintf("QUEUE_TEST_3 FINISHED\n");
 }
 
@@ -105,6 +107,47 @@ void queue_test_4(void) {
 
     size = pcb_size(queue);
     ASSERT_EQUAL(size, 0);
-    kfree(queue);
+    free_pcb_queue(queue);
     kprintf("QUEUE_TEST_4 FINISHED\n");
 }
+
+/**
+ * Removing from the middle, head and tail keeps the links in both directions,
+ * and a pcb is only removed from the queue it is on
+ */
+void queue_test_5(void) {
+    pcb_queue_t *queue = init_pcb_queue();
+    pcb_queue_t *other = init_pcb_queue();
+    pcb_t *pcb_array[5];
+    for(int i=0; i<5; i++) {
+        pcb_array[i] = (pcb_t *) kmalloc(sizeof(pcb_t));
+        pcb_array[i]->pid = i+1;
+        pcb_offer(queue, pcb_array[i]);
+    }
+
+    ASSERT_EQUAL(pcb_remove(other, pcb_array[2]), FALSE);
+    ASSERT_EQUAL(pcb_remove(queue, pcb_array[2]), TRUE);
+    ASSERT_EQUAL(pcb_remove(queue, pcb_array[2]), FALSE);
+    ASSERT_EQUAL(pcb_array[1]->next, pcb_array[3]);
+    ASSERT_EQUAL(pcb_array[3]->prev, pcb_array[1]);
+
+    ASSERT_EQUAL(pcb_remove(queue, pcb_array[0]), TRUE);
+    ASSERT_EQUAL(pcb_remove(queue, pcb_array[4]), TRUE);
+    ASSERT_EQUAL(pcb_peek(queue), pcb_array[1]);
+    ASSERT_EQUAL(pcb_size(queue), 2);
+
+    pcb_insert_before(queue, pcb_array[3], pcb_array[2]);
+    pcb_offer(other, pcb_array[0]);
+    ASSERT_EQUAL(pcb_poll(queue), pcb_array[1]);
+    ASSERT_EQUAL(pcb_poll(queue), pcb_array[2]);
+    ASSERT_EQUAL(pcb_poll(queue), pcb_array[3]);
+    ASSERT_EQUAL(pcb_poll(queue), NULL);
+    ASSERT_EQUAL(pcb_poll(other), pcb_array[0]);
+
+    for(int i=0; i<5; i++) {
+        kfree(pcb_array[i]);
+    }
+    free_pcb_queue(queue);
+    free_pcb_queue(other);
+    kprintf("QUEUE_TEST_5 FINISHED\n");
+}
@@ -0,0 +1,164 @@
+/* pingpongtest.c : send/recv round trip throughput tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+#define PINGPONG_TEST_MS 1000
+#define PINGPONG_BUSY_PROCS 3 /* Cpu bound processes competing with the pair */
+
+static void root_test(void);
+static void pingpong_test_1(void);
+static void pingpong_test_2(void);
+static void pingpong_test_3(void);
+static long run_pingpong(int busy_procs, funcptr client, funcptr server);
+static void pinger(void);
+static void ponger(void);
+static void rpc_client(void);
+static void rpc_server(void);
+static void busy_loop(void);
+
+static pid_t ponger_pid;
+static long round_trips;
+
+void run_pingpong_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    kprintf("Ping-pong tests built with IPC_FASTPATH=%d\n", IPC_FASTPATH);
+    pingpong_test_1();
+    pingpong_test_2();
+    pingpong_test_3();
+
+    sysputs("Done all ping-pong tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Round trips per second between a client and a server with nothing else
+ * ready to run
+ */
+void pingpong_test_1(void) {
+    long rate = run_pingpong(0, pinger, ponger);
+    kprintf("Idle system: %d round trips per second\n", rate);
+    ASSERT(rate > 0);
+    kprintf("PINGPONG TEST 1 FINISHED\n");
+}
+
+/**
+ * Round trips per second while cpu bound processes share the ready queue.
+ * Without the fast path every hop waits behind them, with it the pair keeps
+ * the cpu until its quantum runs out.
+ */
+void pingpong_test_2(void) {
+    schedStatuses ss;
+    ASSERT_EQUAL(sysgetschedstats(&ss), 0);
+    long handoffs = ss.ipcHandoffs;
+
+    long rate = run_pingpong(PINGPONG_BUSY_PROCS, pinger, ponger);
+    kprintf("%d busy processes: %d round trips per second\n", PINGPONG_BUSY_PROCS, rate);
+    ASSERT(rate > 0);
+
+    ASSERT_EQUAL(sysgetschedstats(&ss), 0);
+    kprintf("%d direct handoffs\n", ss.ipcHandoffs - handoffs);
+    ASSERT(!IPC_FASTPATH || ss.ipcHandoffs > handoffs);
+    kprintf("PINGPONG TEST 2 FINISHED\n");
+}
+
+/**
+ * The same exchange with syssendrecv and sysreplywait, one trap per side per
+ * round trip instead of two
+ */
+void pingpong_test_3(void) {
+    long rate = run_pingpong(0, rpc_client, rpc_server);
+    kprintf("Idle system, sendrecv/replywait: %d round trips per second\n", rate);
+    ASSERT(rate > 0);
+
+    rate = run_pingpong(PINGPONG_BUSY_PROCS, rpc_client, rpc_server);
+    kprintf("%d busy processes, sendrecv/replywait: %d round trips per second\n",
+            PINGPONG_BUSY_PROCS, rate);
+    ASSERT(rate > 0);
+    kprintf("PINGPONG TEST 3 FINISHED\n");
+}
+
+/**
+ * Let a client and server exchange messages for PINGPONG_TEST_MS alongside
+ * busy_procs cpu bound processes.
+ * Returns the number of round trips per second.
+ */
+static long run_pingpong(int busy_procs, funcptr client, funcptr server) {
+    pid_t busy[PINGPONG_BUSY_PROCS];
+
+    for (int i = 0; i < busy_procs; i++) {
+        busy[i] = syscreate(busy_loop, DEFAULT_STACK_SIZE);
+    }
+
+    round_trips = 0;
+    ponger_pid = syscreate(server, DEFAULT_STACK_SIZE);
+    pid_t pinger_pid = syscreate(client, DEFAULT_STACK_SIZE);
+    syssleep(PINGPONG_TEST_MS);
+    long count = round_trips;
+
+    syskill(pinger_pid, KILL_SIGNAL_NUM);
+    syskill(ponger_pid, KILL_SIGNAL_NUM);
+    for (int i = 0; i < busy_procs; i++) {
+        syskill(busy[i], KILL_SIGNAL_NUM);
+    }
+    return count * 1000 / PINGPONG_TEST_MS;
+}
+
+/* Process created by root, sends requests and waits for each reply */
+void pinger(void) {
+    int msg = 0;
+    for(;;) {
+        pid_t from = ponger_pid;
+        syssend(ponger_pid, &msg, sizeof(msg));
+        sysrecv(&from, &msg, sizeof(msg));
+        round_trips++;
+    }
+}
+
+/* Process created by root, replies to every request */
+void ponger(void) {
+    int msg;
+    for(;;) {
+        pid_t from = 0;
+        if (sysrecv(&from, &msg, sizeof(msg)) > 0) {
+            msg++;
+            syssend(from, &msg, sizeof(msg));
+        }
+    }
+}
+
+/* Process created by root, sends requests with a single call per reply */
+void rpc_client(void) {
+    int msg = 0;
+    for(;;) {
+        int reply;
+        ASSERT_EQUAL(syssendrecv(ponger_pid, &msg, sizeof(msg), &reply, sizeof(reply)), sizeof(reply));
+        ASSERT_EQUAL(reply, msg + 1);
+        msg = reply;
+        round_trips++;
+    }
+}
+
+/* Process created by root, replies to a request and takes the next in one call */
+void rpc_server(void) {
+    int msg;
+    pid_t client = 0;
+    for(;;) {
+        if (sysreplywait(&client, &msg, sizeof(msg), &msg, sizeof(msg)) > 0) {
+            msg++;
+        } else {
+            client = 0;
+        }
+    }
+}
+
+/* Process created by root */
+void busy_loop(void) {
+    for(;;);
+}
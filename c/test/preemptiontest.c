@@ -4,16 +4,29 @@
 #include <xeroskernel.h>
 #include <pcb.h>
 
+#define QUANTUM_TEST_TICKS 100
+#define QUANTUM_TEST_QUANTUM 5
+
+static void root_test(void);
 static void preemption_test_1(void);
+static void preemption_test_2(void);
 
 static void producer(void);
 static void consumer(void);
+static void busy_loop(void);
+static long switches_of(pid_t pid);
 
 /**
  * Root process launched on system boot. Spawns additional processes
  */
 void run_preemption_tests(void) {
-    create(preemption_test_1, DEFAULT_STACK_SIZE);
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    // Test 2 needs the cpu to itself, test 1 leaves sleepers running
+    preemption_test_2();
+    preemption_test_1();
 }
 
 void preemption_test_1(void) {
@@ -22,6 +35,50 @@ void preemption_test_1(void) {
     kprintf("PREEMPTION TEST 1 FINISHED\n");
 }
 
+/**
+ * A cpu bound process running alone keeps the cpu when its quantum expires,
+ * and two sharing the cpu with a QUANTUM_TEST_QUANTUM tick quantum are each
+ * switched out about once per two quanta.
+ */
+void preemption_test_2(void) {
+    pid_t alone = syscreate(busy_loop, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssetquantum(alone, 0), SYSQUANTUM_INVALID);
+    ASSERT_EQUAL(syssetquantum(alone, QUANTUM_MAX_TICKS + 1), SYSQUANTUM_INVALID);
+    ASSERT_EQUAL(syssetquantum(9999, 1), SYSPID_DNE);
+
+    // Only our own wakeup can take the cpu from it
+    syssleep(QUANTUM_TEST_TICKS * MS_PER_CLOCK_TICK);
+    ASSERT(switches_of(alone) <= 1);
+    syskill(alone, KILL_SIGNAL_NUM);
+
+    pid_t pids[2];
+    for (int i = 0; i < 2; i++) {
+        pids[i] = syscreate(busy_loop, DEFAULT_STACK_SIZE);
+        ASSERT_EQUAL(syssetquantum(pids[i], QUANTUM_TEST_QUANTUM), QUANTUM_DEFAULT_TICKS);
+    }
+    syssleep(QUANTUM_TEST_TICKS * MS_PER_CLOCK_TICK);
+    for (int i = 0; i < 2; i++) {
+        long switches = switches_of(pids[i]);
+        kprintf("pid %d: quantum %d, %d involuntary switches in %d ticks\n",
+                pids[i], QUANTUM_TEST_QUANTUM, switches, QUANTUM_TEST_TICKS);
+        ASSERT(switches <= QUANTUM_TEST_TICKS / QUANTUM_TEST_QUANTUM / 2 + 1);
+        syskill(pids[i], KILL_SIGNAL_NUM);
+    }
+
+    kprintf("PREEMPTION TEST 2 FINISHED\n");
+}
+
+static long switches_of(pid_t pid) {
+    processStatuses ps;
+    int procs = sysgetcputimes(&ps);
+    for (int i = 0; i <= procs; i++) {
+        if (ps.pid[i] == pid) {
+            return ps.involuntarySwitches[i];
+        }
+    }
+    return 0;
+}
+
 /* Process created by root */
 void producer(void) {
     for(;;) {
@@ -37,3 +94,7 @@ void consumer(void) {
     }
 }
 
+/* Process created by root */
+void busy_loop(void) {
+    for(;;);
+}
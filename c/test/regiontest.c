@@ -0,0 +1,198 @@
+/* regiontest.c : region transfer tests and benchmarks
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define REGION_TEST_LEN 256
+#define REGION_BENCH_LEN (64 * 1024)
+#define REGION_BENCH_ROUNDS 200   /* Round trips, two messages each */
+
+static void root_test(void);
+static void region_test_1(void);
+static void region_test_2(void);
+static void region_test_3(void);
+static unsigned long bench(bool transfer);
+static void borrower(void);
+static void hoarder(void);
+static void echo(void);
+
+static pid_t root_pid;
+static int hoarded;
+static bool bench_transfer;
+
+void run_region_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    root_pid = sysgetpid();
+    region_test_1();
+    region_test_2();
+    region_test_3();
+
+    sysputs("Done all region tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * A region moves to its receiver, which can change it and send it back.
+ * Only the owner of a region may send or free it.
+ */
+void region_test_1(void) {
+    ASSERT(sysregionalloc(0) == NULL);
+    char *buf = sysregionalloc(REGION_TEST_LEN);
+    ASSERT(buf != NULL);
+    for (int i = 0; i < REGION_TEST_LEN; i++) {
+        buf[i] = (char)i;
+    }
+    ASSERT_EQUAL(sysregionfree(buf + 1), SYSREGION_NOT_OWNER);
+
+    pid_t pid = syscreate(borrower, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssend_region(pid, buf), sizeof(region_t));
+    ASSERT_EQUAL(sysregionfree(buf), SYSREGION_NOT_OWNER);
+    ASSERT_EQUAL(syssend_region(pid, buf), SYSREGION_NOT_OWNER);
+
+    region_t region;
+    pid_t from = pid;
+    ASSERT_EQUAL(sysrecv(&from, &region, sizeof(region)), sizeof(region));
+    ASSERT(region.base == buf);
+    ASSERT_EQUAL(region.len, REGION_TEST_LEN);
+    for (int i = 0; i < REGION_TEST_LEN; i++) {
+        ASSERT_EQUAL(buf[i], (char)~i);
+    }
+    syswait(pid);
+
+    ASSERT_EQUAL(sysregionfree(buf), 0);
+    ASSERT_EQUAL(sysregionfree(buf), SYSREGION_NOT_OWNER);
+    kprintf("REGION TEST 1 FINISHED\n");
+}
+
+/**
+ * The regions of a process are freed when it exits
+ */
+void region_test_2(void) {
+    void *regions[REGION_TABLE_SIZE];
+
+    pid_t pid = syscreate(hoarder, DEFAULT_STACK_SIZE);
+    syswait(pid);
+    ASSERT_EQUAL(hoarded, REGION_TABLE_SIZE);
+
+    for (int i = 0; i < REGION_TABLE_SIZE; i++) {
+        regions[i] = sysregionalloc(REGION_TEST_LEN);
+        ASSERT(regions[i] != NULL);
+    }
+    for (int i = 0; i < REGION_TABLE_SIZE; i++) {
+        ASSERT_EQUAL(sysregionfree(regions[i]), 0);
+    }
+    kprintf("REGION TEST 2 FINISHED\n");
+}
+
+/**
+ * Benchmark of 64 KB messages bounced between two processes, copied by
+ * syssend against handed over by syssend_region
+ */
+void region_test_3(void) {
+    unsigned long copied = bench(FALSE);
+    unsigned long transferred = bench(TRUE);
+    kprintf("%d byte messages: copy %d, transfer %d cycles per message\n",
+            REGION_BENCH_LEN, copied, transferred);
+    kprintf("REGION TEST 3 FINISHED\n");
+}
+
+/**
+ * Bounce a REGION_BENCH_LEN message off an echo process REGION_BENCH_ROUNDS
+ * times, sending a region if transfer is set and copying it otherwise.
+ * Returns the average cycles per message.
+ */
+static unsigned long bench(bool transfer) {
+    char *buf;
+    char *copy_in = NULL;
+    if (transfer) {
+        buf = sysregionalloc(REGION_BENCH_LEN);
+    } else {
+        buf = kmalloc(REGION_BENCH_LEN);
+        copy_in = kmalloc(REGION_BENCH_LEN);
+        ASSERT(copy_in != NULL);
+    }
+    ASSERT(buf != NULL);
+
+    bench_transfer = transfer;
+    pid_t pid = syscreate(echo, DEFAULT_STACK_SIZE);
+    unsigned long start = read_tsc();
+    for (int i = 0; i < REGION_BENCH_ROUNDS; i++) {
+        buf[0] = (char)i;
+        pid_t from = pid;
+        if (transfer) {
+            region_t region;
+            ASSERT_EQUAL(syssend_region(pid, buf), sizeof(region_t));
+            ASSERT_EQUAL(sysrecv(&from, &region, sizeof(region)), sizeof(region));
+            ASSERT(region.base == buf);
+            ASSERT_EQUAL(buf[0], (char)(i + 1));
+        } else {
+            ASSERT_EQUAL(syssend(pid, buf, REGION_BENCH_LEN), REGION_BENCH_LEN);
+            ASSERT_EQUAL(sysrecv(&from, copy_in, REGION_BENCH_LEN), REGION_BENCH_LEN);
+            ASSERT_EQUAL(copy_in[0], (char)(i + 1));
+        }
+    }
+    unsigned long cycles = read_tsc() - start;
+    syswait(pid);
+
+    if (transfer) {
+        ASSERT_EQUAL(sysregionfree(buf), 0);
+    } else {
+        kfree(buf);
+        kfree(copy_in);
+    }
+    return cycles / (2 * REGION_BENCH_ROUNDS);
+}
+
+/* Process created by root, changes the region it is sent and returns it */
+void borrower(void) {
+    region_t region;
+    pid_t from = root_pid;
+    ASSERT_EQUAL(sysrecv(&from, &region, sizeof(region)), sizeof(region));
+    ASSERT_EQUAL(region.len, REGION_TEST_LEN);
+
+    char *buf = region.base;
+    for (int i = 0; i < REGION_TEST_LEN; i++) {
+        ASSERT_EQUAL(buf[i], (char)i);
+        buf[i] = ~buf[i];
+    }
+    ASSERT_EQUAL(syssend_region(root_pid, buf), sizeof(region_t));
+}
+
+/* Process created by root, takes every region there is and exits */
+void hoarder(void) {
+    hoarded = 0;
+    while (sysregionalloc(REGION_TEST_LEN) != NULL) {
+        hoarded++;
+    }
+}
+
+/* Process created by root, returns each message it is sent with its first byte incremented */
+void echo(void) {
+    char *buf = NULL;
+    if (!bench_transfer) {
+        buf = kmalloc(REGION_BENCH_LEN);
+        ASSERT(buf != NULL);
+    }
+
+    for (int i = 0; i < REGION_BENCH_ROUNDS; i++) {
+        pid_t from = root_pid;
+        if (bench_transfer) {
+            region_t region;
+            ASSERT_EQUAL(sysrecv(&from, &region, sizeof(region)), sizeof(region));
+            ((char *)region.base)[0]++;
+            ASSERT_EQUAL(syssend_region(root_pid, region.base), sizeof(region_t));
+        } else {
+            ASSERT_EQUAL(sysrecv(&from, buf, REGION_BENCH_LEN), REGION_BENCH_LEN);
+            buf[0]++;
+            ASSERT_EQUAL(syssend(root_pid, buf, REGION_BENCH_LEN), REGION_BENCH_LEN);
+        }
+    }
+    if (!bench_transfer) {
+        kfree(buf);
+    }
+}
@@ -0,0 +1,150 @@
+/* ringtest.c : batched syscall ring tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define RING_BENCH_WRITES 1000
+#define RING_MSG_LEN 8
+
+static void root_test(void);
+static void ring_test_1(void);
+static void ring_test_2(void);
+static void ring_bench_1(void);
+static void submit(int request, unsigned long arg0, unsigned long arg1,
+        unsigned long arg2, unsigned long user_data);
+static void late_receiver(void);
+static void worker(void);
+
+/* Too big for a process stack, allocated by the root */
+static sysring_t *ring;
+static pid_t ring_root_pid;
+
+void run_ring_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    ring_root_pid = sysgetpid();
+    ring = kmalloc(sizeof(sysring_t));
+    ASSERT(ring != NULL);
+    ASSERT_EQUAL(sysringenter(), SYSERR);
+    ASSERT_EQUAL(sysringsetup(ring), 0);
+
+    ring_test_1();
+    ring_test_2();
+    ring_bench_1();
+
+    ASSERT_EQUAL(sysringsetup(NULL), 0);
+    kfree(ring);
+    sysputs("Done all ring tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Requests that don't block complete in submission order within one call,
+ * and requests that can't be batched fail without stopping the rest
+ */
+void ring_test_1(void) {
+    submit(SYSCALL_CREATE, (unsigned long)worker, DEFAULT_STACK_SIZE, 0, 1);
+    submit(SYSCALL_YIELD, 0, 0, 0, 2);
+    submit(SYSCALL_GETPID, 0, 0, 0, 3);
+    submit(SYSCALL_CREATE, (unsigned long)worker, DEFAULT_STACK_SIZE, 0, 4);
+
+    ASSERT_EQUAL(sysringenter(), 4);
+    ASSERT_EQUAL(ring->cq_tail - ring->cq_head, 4);
+
+    for (unsigned long i = 1; i <= 4; i++) {
+        sysring_cqe_t *cqe = &ring->cq[ring->cq_head++ % SYSRING_SIZE];
+        ASSERT_EQUAL(cqe->user_data, i);
+        if (i == 2) {
+            ASSERT_EQUAL(cqe->result, SYSRING_OP_INVALID);
+        } else if (i == 3) {
+            ASSERT_EQUAL(cqe->result, ring_root_pid);
+        } else {
+            ASSERT(cqe->result > 0);
+            syskill(cqe->result, KILL_SIGNAL_NUM);
+        }
+    }
+    kprintf("RING TEST 1 FINISHED\n");
+}
+
+/**
+ * A send to a process that isn't receiving yet holds up the rest of the
+ * batch until the message is taken
+ */
+void ring_test_2(void) {
+    char msg[RING_MSG_LEN] = "ring";
+    unsigned long ticks;
+    pid_t receiver = syscreate(late_receiver, DEFAULT_STACK_SIZE);
+
+    submit(SYSCALL_SEND, receiver, (unsigned long)msg, sizeof(msg), 1);
+    submit(SYSCALL_GETPID, 0, 0, 0, 2);
+    ticks = sysgetticks();
+    ASSERT_EQUAL(sysringenter(), 2);
+    ASSERT(sysgetticks() > ticks);
+
+    sysring_cqe_t *cqe = &ring->cq[ring->cq_head++ % SYSRING_SIZE];
+    ASSERT_EQUAL(cqe->user_data, 1);
+    ASSERT_EQUAL(cqe->result, sizeof(msg));
+    cqe = &ring->cq[ring->cq_head++ % SYSRING_SIZE];
+    ASSERT_EQUAL(cqe->user_data, 2);
+    ASSERT_EQUAL(cqe->result, ring_root_pid);
+    kprintf("RING TEST 2 FINISHED\n");
+}
+
+/**
+ * Cycles for RING_BENCH_WRITES syswrite calls against the same writes
+ * submitted as one batch
+ */
+void ring_bench_1(void) {
+    char buffer[RING_MSG_LEN];
+    int fd = sysopen(DEV_ID_KEYBOARD);
+
+    unsigned long start = read_tsc();
+    for (int i = 0; i < RING_BENCH_WRITES; i++) {
+        syswrite(fd, buffer, sizeof(buffer));
+    }
+    unsigned long trap_cycles = read_tsc() - start;
+
+    start = read_tsc();
+    for (int i = 0; i < RING_BENCH_WRITES; i++) {
+        submit(SYSCALL_WRITE, fd, (unsigned long)buffer, sizeof(buffer), i);
+    }
+    ASSERT_EQUAL(sysringenter(), RING_BENCH_WRITES);
+    ring->cq_head = ring->cq_tail;
+    unsigned long ring_cycles = read_tsc() - start;
+
+    sysclose(fd);
+    kprintf("%d writes: %d cycles with syswrite, %d cycles batched\n",
+            RING_BENCH_WRITES, trap_cycles, ring_cycles);
+    kprintf("RING BENCH 1 FINISHED\n");
+}
+
+/**
+ * Queue a request on the ring
+ */
+static void submit(int request, unsigned long arg0, unsigned long arg1,
+        unsigned long arg2, unsigned long user_data) {
+    sysring_sqe_t *sqe = &ring->sq[ring->sq_tail % SYSRING_SIZE];
+    sqe->request = request;
+    sqe->args[0] = arg0;
+    sqe->args[1] = arg1;
+    sqe->args[2] = arg2;
+    sqe->user_data = user_data;
+    ring->sq_tail++;
+}
+
+/* Process created by root, receives one message once the root has blocked */
+void late_receiver(void) {
+    char buffer[RING_MSG_LEN];
+    pid_t from = ring_root_pid;
+    syssleep(MS_PER_CLOCK_TICK);
+    ASSERT_EQUAL(sysrecv(&from, buffer, sizeof(buffer)), sizeof(buffer));
+}
+
+/* Process created by root */
+void worker(void) {
+    for(;;);
+}
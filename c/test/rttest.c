@@ -0,0 +1,158 @@
+/* rttest.c : real-time (EDF) class tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define RT_TICKS(n) ((n) * MS_PER_CLOCK_TICK)
+
+#define EDF_PERIOD 20             /* Clock ticks, both tasks share it */
+#define EDF_BUDGET 5
+#define EDF_URGENT_DEADLINE 10
+#define EDF_RELAXED_DEADLINE 20
+#define EDF_WORK 3                /* Ticks each job spins, less than its budget */
+#define EDF_JOBS 10
+
+#define MISS_PERIOD 20
+#define MISS_BUDGET 2
+#define MISS_DEADLINE 5
+#define MISS_SLEEP 8              /* Past the deadline, short of the next release */
+#define MISS_JOBS 5
+#define HOG_TICKS 100             /* Time the budget-bound task runs for, five of its periods */
+
+static void root_test(void);
+static void rt_test_1(void);
+static void rt_test_2(void);
+static void edf_jobs(int id, unsigned int deadline);
+static void spin(int ticks);
+static int misses_of(pid_t pid);
+static void edf_urgent(void);
+static void edf_relaxed(void);
+static void late_sleeper(void);
+static void hog(void);
+
+static int edf_log[2 * EDF_JOBS];
+static int edf_logged;
+static int edf_misses[2];
+static int sleeper_misses;
+static volatile bool hog_stop;
+
+void run_rt_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    rt_test_1();
+    rt_test_2();
+
+    sysputs("Done all real-time tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Two tasks released together in every period complete earliest deadline
+ * first, and neither misses a deadline
+ */
+void rt_test_1(void) {
+    edf_logged = 0;
+    pid_t urgent = syscreate(edf_urgent, DEFAULT_STACK_SIZE);
+    pid_t relaxed = syscreate(edf_relaxed, DEFAULT_STACK_SIZE);
+    syswait(urgent);
+    syswait(relaxed);
+
+    ASSERT_EQUAL(edf_logged, 2 * EDF_JOBS);
+    for (int i = 0; i < EDF_JOBS; i++) {
+        ASSERT_EQUAL(edf_log[2 * i], 0);
+        ASSERT_EQUAL(edf_log[2 * i + 1], 1);
+    }
+    ASSERT_EQUAL(edf_misses[0], 0);
+    ASSERT_EQUAL(edf_misses[1], 0);
+    kprintf("RT TEST 1 FINISHED\n");
+}
+
+/**
+ * A job still unfinished at its deadline is counted as missed exactly once.
+ * A job that ends by using its whole budget is not a miss.
+ */
+void rt_test_2(void) {
+    pid_t pid = syscreate(late_sleeper, DEFAULT_STACK_SIZE);
+    syswait(pid);
+    ASSERT_EQUAL(sleeper_misses, MISS_JOBS);
+
+    hog_stop = FALSE;
+    pid = syscreate(hog, DEFAULT_STACK_SIZE);
+    syssleep(RT_TICKS(HOG_TICKS));
+    int hog_misses = misses_of(pid);
+    hog_stop = TRUE;
+    syswait(pid);
+    ASSERT_EQUAL(hog_misses, 0);
+    kprintf("RT TEST 2 FINISHED\n");
+}
+
+/**
+ * Run EDF_JOBS jobs of EDF_WORK ticks, logging id as each one completes
+ */
+static void edf_jobs(int id, unsigned int deadline) {
+    ASSERT_EQUAL(syssetrt(RT_TICKS(EDF_PERIOD), RT_TICKS(EDF_BUDGET), RT_TICKS(deadline)), 0);
+    // End the job released on admission, the next ones are released in step
+    sysyield();
+
+    for (int i = 0; i < EDF_JOBS; i++) {
+        spin(EDF_WORK);
+        edf_log[edf_logged++] = id;
+        sysyield();
+    }
+    edf_misses[id] = misses_of(sysgetpid());
+    ASSERT_EQUAL(syssetrt(0, 0, 0), 0);
+}
+
+/**
+ * Busy wait until ticks clock ticks have passed
+ */
+static void spin(int ticks) {
+    unsigned long start = sysgetticks();
+    while (sysgetticks() - start < ticks);
+}
+
+/**
+ * Deadlines missed by the process, from sysgetcputimes()
+ */
+static int misses_of(pid_t pid) {
+    processStatuses ps;
+    int procs = sysgetcputimes(&ps);
+    for (int i = 0; i <= procs; i++) {
+        if (ps.pid[i] == pid) {
+            return ps.deadlineMisses[i];
+        }
+    }
+    return -1;
+}
+
+/* Process created by root, the earlier deadline of the pair */
+void edf_urgent(void) {
+    edf_jobs(0, EDF_URGENT_DEADLINE);
+}
+
+/* Process created by root, the later deadline of the pair */
+void edf_relaxed(void) {
+    edf_jobs(1, EDF_RELAXED_DEADLINE);
+}
+
+/* Process created by root, sleeps through the deadline of every job */
+void late_sleeper(void) {
+    ASSERT_EQUAL(syssetrt(RT_TICKS(MISS_PERIOD), RT_TICKS(MISS_BUDGET), RT_TICKS(MISS_DEADLINE)), 0);
+    for (int i = 0; i < MISS_JOBS; i++) {
+        syssleep(RT_TICKS(MISS_SLEEP));
+        sysyield();
+    }
+    sleeper_misses = misses_of(sysgetpid());
+    ASSERT_EQUAL(syssetrt(0, 0, 0), 0);
+}
+
+/* Process created by root, runs every job until its budget is gone */
+void hog(void) {
+    ASSERT_EQUAL(syssetrt(RT_TICKS(MISS_PERIOD), RT_TICKS(MISS_BUDGET), RT_TICKS(MISS_DEADLINE)), 0);
+    while (!hog_stop);
+    ASSERT_EQUAL(syssetrt(0, 0, 0), 0);
+}
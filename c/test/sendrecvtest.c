@@ -11,6 +11,7 @@
 static void sendrecv_test_1(void);
 static void sendrecv_test_2(void);
 static void sendrecv_test_3(void);
+static void sendrecv_test_4(void);
 
 static void sendrecv1(void);
 static void sender1(void);
@@ -25,6 +26,10 @@ static void sendrecv3(void);
 static void sender4(void);
 static void receiver3(void);
 
+static void sendrecv4(void);
+static void late_sender(void);
+static void idle_sleeper(void);
+
 static pid_t rootpid1;
 static pid_t sendpid1;
 static pid_t recvpid1;
@@ -38,10 +43,13 @@ static pid_t rootpid3;
 static pid_t sendpid4;
 static pid_t recvpid3;
 
+static pid_t rootpid4;
+
 void run_sendrecv_tests(void) {
     sendrecv_test_1();
     sendrecv_test_2();
     sendrecv_test_3();
+    sendrecv_test_4();
 }
 
 void sendrecv_test_1(void) {
@@ -56,6 +64,10 @@ void sendrecv_test_3(void) {
     create(sendrecv3, DEFAULT_STACK_SIZE);
 }
 
+void sendrecv_test_4(void) {
+    create(sendrecv4, DEFAULT_STACK_SIZE);
+}
+
 void sendrecv1(void) {
     rootpid1 = sysgetpid();
     syscreate(sender1, DEFAULT_STACK_SIZE);
@@ -78,6 +90,36 @@ void sendrecv3(void) {
     kprintf("SENDRECV TEST 3 FINISHED\n");
 }
 
+/**
+ * sysrecvtim and syssendtim give up with TIMEOUT after their time, or at once
+ * for a timeout of 0, and a message that arrives first disarms the timer. A
+ * bad buffer is not mistaken for a timeout.
+ */
+void sendrecv4(void) {
+    rootpid4 = sysgetpid();
+    char buffer[16];
+    pid_t from = 0;
+
+    ASSERT_EQUAL(sysrecvtim(&from, NULL, sizeof(buffer), 0), SYSERR_OTHER);
+    ASSERT_EQUAL(sysrecvtim(&from, buffer, sizeof(buffer), 0), TIMEOUT);
+    unsigned long start = sysgetticks();
+    ASSERT_EQUAL(sysrecvtim(&from, buffer, sizeof(buffer), 5 * MS_PER_CLOCK_TICK), TIMEOUT);
+    ASSERT(sysgetticks() - start >= 5);
+
+    pid_t sender = syscreate(late_sender, DEFAULT_STACK_SIZE);
+    from = sender;
+    ASSERT_EQUAL(sysrecvtim(&from, buffer, sizeof(buffer), 50 * MS_PER_CLOCK_TICK), 16);
+    sysputs(buffer);
+    // The disarmed timeout must not fire into the sleep
+    ASSERT_EQUAL(syssleep(60 * MS_PER_CLOCK_TICK), 0);
+
+    pid_t sleeper = syscreate(idle_sleeper, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssendtim(sleeper, buffer, sizeof(buffer), 0), TIMEOUT);
+    ASSERT_EQUAL(syssendtim(sleeper, buffer, sizeof(buffer), 5 * MS_PER_CLOCK_TICK), TIMEOUT);
+    syskill(sleeper, KILL_SIGNAL_NUM);
+    kprintf("SENDRECV TEST 4 FINISHED\n");
+}
+
 void sender1(void) {
     sendpid1 = sysgetpid();
     sysyield();
@@ -133,3 +175,14 @@ void receiver3(void) {
     sprintf(message, "Error code: %d\n", status);
     sysputs(message);
 }
+
+/* Process created by sendrecv4, sends to it after a few ticks */
+void late_sender(void) {
+    syssleep(3 * MS_PER_CLOCK_TICK);
+    ASSERT_EQUAL(syssend(rootpid4, "hello world 4!\n", 16), 16);
+}
+
+/* Process created by sendrecv4, never receives */
+void idle_sleeper(void) {
+    syssleep(1000 * MS_PER_CLOCK_TICK);
+}
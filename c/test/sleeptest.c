@@ -0,0 +1,144 @@
+/* sleeptest.c : sleep and timing wheel tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+#define SLEEP_TEST_SLEEPERS (PCB_TABLE_SIZE - 2)
+#define SLEEP_TEST_SPREAD_MS 97   /* Steps between sleepers, lands them on wheel levels 0 and 1 */
+#define SLEEP_TEST_LONG_MS 5000
+#define SLEEP_TEST_SIGNAL 5
+
+static void root_test(void);
+static void sleep_test_1(void);
+static void sleep_test_2(void);
+static void sleep_test_3(void);
+static void sleeper(void);
+static void long_sleeper(void);
+static void handler(void *cntx);
+
+static int wake_errors;
+static int sleepers_done;
+static unsigned int sleep_left;
+
+/* Sleeps in ticks for sleep_test_3, on and around the boundaries of every wheel level */
+static const unsigned long cascade_ticks[] = {
+    1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145, 300000
+};
+#define CASCADE_SLEEPERS (sizeof(cascade_ticks) / sizeof(cascade_ticks[0]))
+
+void run_sleep_tests(void) {
+    sleep_test_3();
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    sleep_test_1();
+    sleep_test_2();
+
+    sysputs("Done all sleep tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * A full sleep returns 0, one cut short by a signal returns the time left
+ */
+void sleep_test_1(void) {
+    unsigned long start = sysgetticks();
+    ASSERT_EQUAL(syssleep(10 * MS_PER_CLOCK_TICK), 0);
+    ASSERT(sysgetticks() - start >= 10);
+
+    pid_t pid = syscreate(long_sleeper, DEFAULT_STACK_SIZE);
+    syssleep(10 * MS_PER_CLOCK_TICK);
+    ASSERT_EQUAL(syskill(pid, SLEEP_TEST_SIGNAL), 0);
+    syswait(pid);
+    kprintf("Interrupted sleep returned %d ms left\n", sleep_left);
+    ASSERT(sleep_left > 0 && sleep_left < SLEEP_TEST_LONG_MS);
+    kprintf("SLEEP TEST 1 FINISHED\n");
+}
+
+/**
+ * Every sleeper wakes on its own tick while the table is full of sleepers
+ * spread over the levels of the wheel
+ */
+void sleep_test_2(void) {
+    pid_t pids[SLEEP_TEST_SLEEPERS];
+
+    wake_errors = 0;
+    sleepers_done = 0;
+    ASSERT_EQUAL(syscreate_many(sleeper, DEFAULT_STACK_SIZE, SLEEP_TEST_SLEEPERS, pids),
+            SLEEP_TEST_SLEEPERS);
+    for (int i = 0; i < SLEEP_TEST_SLEEPERS; i++) {
+        syswait(pids[i]);
+    }
+
+    ASSERT_EQUAL(sleepers_done, SLEEP_TEST_SLEEPERS);
+    ASSERT_EQUAL(wake_errors, 0);
+    kprintf("SLEEP TEST 2 FINISHED\n");
+}
+
+/**
+ * Sleepers placed on every level of the wheel cascade down and wake on
+ * exactly their own tick. Runs before the dispatcher starts, driving the
+ * wheel with tick() itself rather than waiting minutes for the timer.
+ */
+void sleep_test_3(void) {
+    pcb_t *pcbs[CASCADE_SLEEPERS];
+    unsigned long woke[CASCADE_SLEEPERS];
+
+    unsigned long start = get_clock_ticks();
+    for (int i = 0; i < CASCADE_SLEEPERS; i++) {
+        pcbs[i] = get_free_pcb();
+        ASSERT(pcbs[i] != NULL);
+        sleep(pcbs[i], cascade_ticks[i] * MS_PER_CLOCK_TICK);
+        woke[i] = 0;
+    }
+
+    unsigned long last = cascade_ticks[CASCADE_SLEEPERS - 1];
+    while (get_clock_ticks() - start < last) {
+        tick();
+        for (int i = 0; i < CASCADE_SLEEPERS; i++) {
+            if (woke[i] == 0 && pcbs[i]->state == PROC_STATE_READY) {
+                woke[i] = get_clock_ticks() - start;
+            }
+        }
+    }
+
+    for (int i = 0; i < CASCADE_SLEEPERS; i++) {
+        ASSERT_EQUAL(woke[i], cascade_ticks[i]);
+        ASSERT(remove_pcb_from_ready_queue(pcbs[i]));
+        add_pcb_to_stopped_queue(pcbs[i]);
+    }
+    kprintf("SLEEP TEST 3 FINISHED\n");
+}
+
+/* Process created by root, sleeps for a time set by its creation order */
+void sleeper(void) {
+    static int next_index;
+    unsigned int ms = (++next_index % SLEEP_TEST_SLEEPERS + 1) * SLEEP_TEST_SPREAD_MS;
+    unsigned long ticks = (ms + MS_PER_CLOCK_TICK - 1) / MS_PER_CLOCK_TICK;
+
+    unsigned long start = sysgetticks();
+    ASSERT_EQUAL(syssleep(ms), 0);
+    unsigned long slept = sysgetticks() - start;
+
+    // It may get the cpu a little after its tick, never before
+    if (slept < ticks || slept > ticks + 2) {
+        kprintf("Slept %d ticks for %d\n", slept, ticks);
+        wake_errors++;
+    }
+    sleepers_done++;
+}
+
+/* Process created by root, sleeps until root signals it */
+void long_sleeper(void) {
+    funcptr_args old_handler;
+    ASSERT_EQUAL(syssighandler(SLEEP_TEST_SIGNAL, handler, &old_handler), 0);
+    sleep_left = syssleep(SLEEP_TEST_LONG_MS);
+}
+
+/* Signal handler of long_sleeper */
+void handler(void *cntx) {
+}
@@ -0,0 +1,146 @@
+/* stridetest.c : stride scheduling tests
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+#include <pcb.h>
+
+#define STRIDE_TEST_TICKS 10000
+#define STRIDE_TEST_TOLERANCE 30 /* Allowed error in parts per thousand */
+#define STRIDE_PAIR_TICKETS 10   /* Tickets of each process of the ping-pong pair */
+#define STRIDE_BUSY_TICKETS 80
+
+static void root_test(void);
+static void stride_test_1(void);
+static void stride_test_2(void);
+static void busy_loop(void);
+static void ping(void);
+static void pong(void);
+static long cpu_time_of(processStatuses *ps, int procs, pid_t pid);
+
+static pid_t pong_pid;
+
+void run_stride_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    stride_test_1();
+    stride_test_2();
+
+    sysputs("Done all stride tests. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Three cpu bound processes holding 70/20/10 tickets should receive the cpu
+ * in the same proportion, measured over STRIDE_TEST_TICKS clock ticks.
+ */
+void stride_test_1(void) {
+    int tickets[3] = {70, 20, 10};
+    pid_t pids[3];
+    long times[3];
+    long total = 0;
+    processStatuses psTab;
+
+    if (SCHED_POLICY != SCHED_POLICY_STRIDE) {
+        kprintf("STRIDE TEST 1 SKIPPED: built without SCHED_POLICY_STRIDE\n");
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        pids[i] = syscreate(busy_loop, DEFAULT_STACK_SIZE);
+        ASSERT_EQUAL(syssettickets(pids[i], tickets[i]), STRIDE_DEFAULT_TICKETS);
+    }
+    ASSERT_EQUAL(syssettickets(pids[0], 0), SYSTICKETS_INVALID);
+    ASSERT_EQUAL(syssettickets(9999, 10), SYSPID_DNE);
+
+    // Root holds the cpu only long enough to sleep, so the workers share every tick
+    syssleep(STRIDE_TEST_TICKS * MS_PER_CLOCK_TICK);
+
+    int procs = sysgetcputimes(&psTab);
+    for (int i = 0; i < 3; i++) {
+        times[i] = cpu_time_of(&psTab, procs, pids[i]);
+        total += times[i];
+    }
+    ASSERT(total > 0);
+
+    for (int i = 0; i < 3; i++) {
+        long share = times[i] * 1000 / total;
+        kprintf("pid %d: tickets %d, cpu %d ms, share %d/1000\n",
+                pids[i], tickets[i], times[i], share);
+        ASSERT(abs(share - tickets[i] * 10) <= STRIDE_TEST_TOLERANCE);
+        syskill(pids[i], KILL_SIGNAL_NUM);
+    }
+
+    kprintf("STRIDE TEST 1 FINISHED\n");
+}
+
+/**
+ * A client and server exchanging messages hold STRIDE_PAIR_TICKETS each
+ * against a cpu bound process holding STRIDE_BUSY_TICKETS. Handing the cpu
+ * straight to the IPC partner must not let the pair run ahead of its pass,
+ * so the cpu bound process still gets at least its share.
+ */
+void stride_test_2(void) {
+    processStatuses psTab;
+
+    if (SCHED_POLICY != SCHED_POLICY_STRIDE) {
+        kprintf("STRIDE TEST 2 SKIPPED: built without SCHED_POLICY_STRIDE\n");
+        return;
+    }
+
+    pid_t busy = syscreate(busy_loop, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssettickets(busy, STRIDE_BUSY_TICKETS), STRIDE_DEFAULT_TICKETS);
+    pong_pid = syscreate(pong, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssettickets(pong_pid, STRIDE_PAIR_TICKETS), STRIDE_DEFAULT_TICKETS);
+    pid_t ping_pid = syscreate(ping, DEFAULT_STACK_SIZE);
+    ASSERT_EQUAL(syssettickets(ping_pid, STRIDE_PAIR_TICKETS), STRIDE_DEFAULT_TICKETS);
+
+    syssleep(STRIDE_TEST_TICKS * MS_PER_CLOCK_TICK);
+
+    int procs = sysgetcputimes(&psTab);
+    long share = cpu_time_of(&psTab, procs, busy) * 1000 / (STRIDE_TEST_TICKS * MS_PER_CLOCK_TICK);
+    kprintf("pid %d: tickets %d against a ping-pong pair, share %d/1000\n",
+            busy, STRIDE_BUSY_TICKETS, share);
+    ASSERT(share >= STRIDE_BUSY_TICKETS * 10 - STRIDE_TEST_TOLERANCE);
+
+    syskill(ping_pid, KILL_SIGNAL_NUM);
+    syskill(pong_pid, KILL_SIGNAL_NUM);
+    syskill(busy, KILL_SIGNAL_NUM);
+    kprintf("STRIDE TEST 2 FINISHED\n");
+}
+
+static long cpu_time_of(processStatuses *ps, int procs, pid_t pid) {
+    for (int i = 0; i <= procs; i++) {
+        if (ps->pid[i] == pid) {
+            return ps->cpuTime[i];
+        }
+    }
+    return 0;
+}
+
+void busy_loop(void) {
+    for(;;);
+}
+
+/* Process created by root, sends requests to pong and waits for each reply */
+void ping(void) {
+    int msg = 0;
+    for(;;) {
+        pid_t from = pong_pid;
+        syssend(pong_pid, &msg, sizeof(msg));
+        sysrecv(&from, &msg, sizeof(msg));
+    }
+}
+
+/* Process created by root, replies to every request from ping */
+void pong(void) {
+    int msg;
+    for(;;) {
+        pid_t from = 0;
+        sysrecv(&from, &msg, sizeof(msg));
+        syssend(from, &msg, sizeof(msg));
+    }
+}
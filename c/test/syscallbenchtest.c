@@ -0,0 +1,69 @@
+/* syscallbenchtest.c : system call entry and dispatch benchmarks
+ */
+
+#include <xeroskernel.h>
+#include <kerneltest.h>
+#include <xeroslib.h>
+
+#define SYSCALL_BENCH_CALLS 10000
+
+static void root_test(void);
+static void syscall_bench_1(void);
+static void syscall_bench_2(void);
+static unsigned long getpid_cycles(void);
+
+void run_syscall_bench_tests(void) {
+    create(root_test, DEFAULT_STACK_SIZE);
+}
+
+void root_test(void) {
+    syscall_bench_1();
+    syscall_bench_2();
+
+    sysputs("Done all syscall benchmarks. Looping.\n");
+    for(;;);
+}
+
+/**
+ * Average cycles for a getpid round trip into the kernel and back, the
+ * cheapest syscall there is. Nearly all of it is trap entry, argument
+ * decoding and dispatch.
+ */
+void syscall_bench_1(void) {
+    kprintf("%d cycles per getpid syscall\n", getpid_cycles());
+    kprintf("SYSCALL BENCH 1 FINISHED\n");
+}
+
+/**
+ * The same null syscall through the int gate and through sysenter, when the
+ * cpu supports it
+ */
+void syscall_bench_2(void) {
+    int entry = syscall_entry;
+
+    syscall_entry = SYSCALL_ENTRY_INT;
+    kprintf("int $%d: %d cycles per getpid syscall\n", SYSCALL_INT_NUM, getpid_cycles());
+
+    if (entry == SYSCALL_ENTRY_SYSENTER) {
+        syscall_entry = SYSCALL_ENTRY_SYSENTER;
+        kprintf("sysenter: %d cycles per getpid syscall\n", getpid_cycles());
+    } else {
+        kprintf("sysenter not supported\n");
+    }
+
+    syscall_entry = entry;
+    kprintf("SYSCALL BENCH 2 FINISHED\n");
+}
+
+/**
+ * Average cycles per getpid syscall over SYSCALL_BENCH_CALLS calls
+ */
+static unsigned long getpid_cycles(void) {
+    pid_t pid = sysgetpid();
+
+    unsigned long start = read_tsc();
+    for (int i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        ASSERT_EQUAL(syscall(SYSCALL_GETPID, 0), pid);
+    }
+    return (read_tsc() - start) / SYSCALL_BENCH_CALLS;
+}
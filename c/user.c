@@ -25,7 +25,8 @@ static char *detailed_states[] = {
     "BLOCKED: RECEIVING",
     "BLOCKED: WAITING",
     "BLOCKED: SLEEPING",
-    "BLOCKED: DEVICE IO"
+    "BLOCKED: DEVICE IO",
+    "BLOCKED: PERIOD"
 };
 
 
@@ -197,7 +198,8 @@ static int get_command(char* str, char* command, char* arg) {
 }
 
 /**
- * Lists all current active processes in a table
+ * Lists all current active processes in a table. The table comes from the
+ * kernel info page, so listing it does not enter the kernel.
  */
 static void command_ps(void) {
     processStatuses ps;
@@ -205,10 +207,11 @@ static void command_ps(void) {
 
     int num = sysgetcputimes(&ps);
 
-    sysputs("PID | State           | Time\n");
+    sysputs("PID | State              | Prio | Time     | Misses | Preempt\n");
     for (int i = 0; i <= num; i++) {
-        sprintf(str, "%4d  %16s  %8d\n", ps.pid[i],
-                detailed_states[ps.status[i]], ps.cpuTime[i]);
+        sprintf(str, "%4d  %19s  %4d  %8d  %6d  %7d\n", ps.pid[i],
+                detailed_states[ps.status[i]], ps.priority[i], ps.cpuTime[i],
+                ps.deadlineMisses[i], ps.involuntarySwitches[i]);
         sysputs(str);
     }
 }
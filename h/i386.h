@@ -77,6 +77,30 @@ struct segtr {
 #define HOLEEND         ((1024 + HOLESIZE) * 1024)
 /* Extra 600 for bootp loading, and monitor */
 
+/* Memory size left by setup.S in the boot parameters at 0x90000 */
+#define BOOT_EXT_MEM_K  (*(unsigned short *)0x90002) /* KB of memory above 1 MB */
+#define BOOT_E820_NR    (*(unsigned short *)0x900a0) /* Entries in the BIOS memory map */
+#define BOOT_E820_SIG   (*(unsigned short *)0x900a2) /* BOOT_E820_MAGIC if setup.S wrote BOOT_E820_NR */
+#define BOOT_E820_MAP   ((e820_entry_t *)0x900a4)   /* The BIOS memory map */
+#define BOOT_E820_MAX   16      /* Entries setup.S has room for */
+#define BOOT_E820_MAGIC 0xe820
+#define E820_RAM        1       /* Type of a usable memory map entry */
+#define RAM_LIMIT       0xf0000000 /* Memory above this is never used */
+#define MAX_RAM_RANGES  BOOT_E820_MAX
+
+/* An entry of the BIOS memory map */
+typedef struct e820_entry {
+    unsigned long long addr;
+    unsigned long long size;
+    unsigned long type;
+} __attribute__((packed)) e820_entry_t;
+
+/* Usable memory from start up to end, both page aligned */
+typedef struct mem_range {
+    unsigned long start;
+    unsigned long end;
+} mem_range_t;
+
 /* Code grokked from cs452 (waterloo) libs
  */
 #define TIMER_IRQ	0	/* IRQ of counter 0 on timer 1 */
@@ -87,6 +111,7 @@ struct segtr {
 #define TIMER_FREQ      1193182
 #endif
 #define TIMER_DIV(x) ((TIMER_FREQ+(x)/2)/(x))
+#define TIMER_MAX_COUNT 0xffff  /* Largest count a 16 bit counter can hold */
 
 /*
  * Macros for specifying values to be written into a mode register.
@@ -110,11 +135,33 @@ struct segtr {
 #define         TIMER_16BIT     0x30    /* r/w counter 16 bits, LSB first */
 #define         TIMER_BCD       0x01    /* count in BCD */
 
+/* Timer 2 is gated and read back through the system control port */
+#define TIMER_GATE_PORT 0x061
+#define         TIMER_GATE2     0x01    /* counter 2 counts while set */
+#define         SPEAKER_DATA    0x02    /* counter 2 output drives the speaker */
+#define         TIMER_OUT2      0x20    /* counter 2 output level */
+
+/* Fast system call entry */
+#define CPUID_FLAG      0x00200000 /* EFLAGS bit that can be toggled when cpuid exists */
+#define CPUID_SEP       0x00000800 /* cpuid 1 edx: sysenter/sysexit supported */
+#define CPUID_TSC       0x00000010 /* cpuid 1 edx: time stamp counter supported */
+#define MSR_SYSENTER_CS  0x174  /* Code segment loaded by sysenter, ss is the next entry */
+#define MSR_SYSENTER_ESP 0x175  /* Stack pointer loaded by sysenter */
+#define MSR_SYSENTER_EIP 0x176  /* Entry point jumped to by sysenter */
+
 /* Keyboard */
 #define KEYBOARD_IRQ     1      /* Keyboard IRQ */
 void setKbdInt( int enable );
 
 /* Some helpful prototypes */
 void initPIT( int divisor );
+void initPITOneShot( unsigned int count );
+unsigned int readPIT( void );
+int irqPending( unsigned int irq );
+int cpuHasSysenter( void );
+int cpuHasTSC( void );
+unsigned long long readTSC( void );
+long sizmem( void );
+void writeMSR( unsigned int msr, unsigned int lo, unsigned int hi );
 void end_of_intr( void );
 
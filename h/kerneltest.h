@@ -11,6 +11,26 @@ void run_preemption_tests(void);
 void run_kill_tests(void);
 void run_signal_tests(void);
 void run_device_tests(void);
+void run_stride_tests(void);
+void run_ipc_bench_tests(void);
+void run_pingpong_tests(void);
+void run_syscall_bench_tests(void);
+void run_kinfo_tests(void);
+void run_ring_tests(void);
+void run_create_bench_tests(void);
+void run_sleep_tests(void);
+void run_hrtimer_tests(void);
+void run_nb_server_tests(void);
+void run_mailbox_tests(void);
+void run_region_tests(void);
+void run_rt_tests(void);
+
+/* Low 32 bits of the time stamp counter, for timing short benchmarks */
+static inline unsigned long read_tsc(void) {
+    unsigned long lo, hi;
+    __asm__ volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
 
 #endif
 
@@ -2,43 +2,65 @@
 
 #include <xeroskernel.h>
 
-/* Struct representing a pcb queue */
-typedef struct pcb_queue {
+/* Struct representing a pcb queue, doubly linked through the pcbs */
+struct pcb_queue {
     pcb_t *head;      /* The head of the queue */
     pcb_t *tail;      /* The tail of the queue */
     int size;         /* Size of the queue */
-} pcb_queue_t;
+};
+
+/* Struct representing a min-heap of pcb's ordered by stride pass */
+typedef struct pcb_heap {
+    pcb_t *entries[PCB_TABLE_SIZE]; /* Heap ordered array, entries[0] has the lowest pass */
+    int size;                       /* Size of the heap */
+} pcb_heap_t;
 
 /* function prototypes for the process queue */
 pcb_queue_t *init_pcb_queue(void);
+void free_pcb_queue(pcb_queue_t *queue);
 int pcb_size(pcb_queue_t *queue);
 pcb_t *pcb_poll(pcb_queue_t *queue);
 pcb_t *pcb_peek(pcb_queue_t *queue);
 void pcb_offer(pcb_queue_t *queue, pcb_t *entry);
+void pcb_insert_before(pcb_queue_t *queue, pcb_t *curr, pcb_t *entry);
 bool pcb_remove(pcb_queue_t *queue, pcb_t *entry);
+void pcb_insert_sorted(pcb_queue_t *queue, pcb_t *entry, bool (*before)(pcb_t *a, pcb_t *b));
 void dump_pcb_queue(pcb_queue_t *queue);
 
+/* function prototypes for the process heap */
+pcb_heap_t *init_pcb_heap(void);
+int pcb_heap_size(pcb_heap_t *heap);
+pcb_t *pcb_heap_peek(pcb_heap_t *heap);
+pcb_t *pcb_heap_poll(pcb_heap_t *heap);
+void pcb_heap_insert(pcb_heap_t *heap, pcb_t *entry);
+bool pcb_heap_remove(pcb_heap_t *heap, pcb_t *entry);
+void dump_pcb_heap(pcb_heap_t *heap);
+
 /* function prototypes for calls related to pcb */
 extern void initpcb(void);
 extern void add_pcb_to_stopped_queue(pcb_t *pcb);
 extern void add_pcb_to_ready_queue(pcb_t *pcb);
 extern bool remove_pcb_from_ready_queue(pcb_t *pcb);
-extern void add_pcb_to_blocked_queue(pcb_t *pcb);
+extern void add_pcb_to_blocked_queue(pcb_t *pcb, pcb_queue_t *queue);
+extern void add_pcb_to_any_receivers(pcb_t *pcb);
 extern bool remove_pcb_from_blocked_queue(pcb_t *pcb);
 extern void add_pcb_to_sleep_queue(pcb_t *pcb);
 extern bool remove_pcb_from_sleep_queue(pcb_t *pcb);
-extern pcb_t *peek_pcb_from_sleep_queue(void);
-extern pcb_t *peek_next_sender(void);
-extern pcb_t *peek_any_receiver(void);
-extern void unblock_pcb_waiting_for_pid(pid_t pid);
+extern void unblock_pcbs_blocked_on(pcb_t *pcb);
 extern pcb_t *get_next_pcb(void);
+extern bool take_pcb_if_next(pcb_t *pcb);
+extern bool ready_queue_empty(void);
+extern bool ready_pcb_preempts(pcb_t *pcb);
+extern void set_pcb_priority(pcb_t *pcb, int priority);
+extern void reset_pcb_priorities(void);
+extern void release_rt_pcbs(unsigned long now);
 extern pcb_t *get_free_pcb(void);
 extern pcb_t *pid_to_pcb(pid_t pid);
 extern void cleanup_pcb(pcb_t *pcb);
 
 extern void dump_stopped_queue(void);
 extern void dump_ready_queue(void);
-extern void dump_blocked_queue(void);
+extern void dump_blocked_queues(pcb_t *pcb);
 extern void dump_sleep_queue(void);
 
 extern int fill_processStatus(pcb_t *pcb, processStatuses *ps);
@@ -25,7 +25,7 @@ typedef unsigned int pid_t;  /* Typedef to represent process id's */
 #define	OK            1         /* system call ok               */
 #define	SYSERR       -1         /* system call failed           */
 #define	EOF          -2         /* End-of-file (usu. from read)	*/
-#define	TIMEOUT      -3         /* time out  (usu. recvtim)     */
+#define	TIMEOUT      -7         /* time out  (usu. recvtim)     */
 #define	INTRMSG      -4         /* keyboard "intr" key pressed	*/
                                 /*  (usu. defined as ^B)        */
 #define	BLOCKERR     -5         /* non-blocking op would block  */
@@ -40,10 +40,64 @@ typedef unsigned int pid_t;  /* Typedef to represent process id's */
 #define DEFAULT_STACK_SIZE 8192   /* Default stack size to use for user processes */
 #define IDLE_PROC_STACK_SIZE 2048 /* Stack size to use for idle process */
 #define MS_PER_CLOCK_TICK 10      /* Milliseconds per clock tick */
+#define CLOCK_TICKS_PER_SECOND (1000 / MS_PER_CLOCK_TICK)
+#define NS_PER_CLOCK_TICK (MS_PER_CLOCK_TICK * 1000000UL)
+
+/* Scheduling priority constants */
+
+#define PRIORITY_LEVELS 32        /* Number of priority levels (one bit each in the ready bitmap) */
+#define PRIORITY_HIGHEST 0        /* Most urgent priority level */
+#define PRIORITY_LOWEST (PRIORITY_LEVELS - 1) /* Least urgent priority level */
+#define PRIORITY_DEFAULT 16       /* Priority given to newly created processes */
+
+/* Scheduling policies. Build with -DSCHED_POLICY=<policy> to select one */
+
+#define SCHED_POLICY_PRIORITY 0   /* Fixed priority, round-robin within a level */
+#define SCHED_POLICY_MLFQ 1       /* Multi-level feedback queue */
+#define SCHED_POLICY_STRIDE 2     /* Proportional share by tickets */
+
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_POLICY_PRIORITY
+#endif
+
+#define MLFQ_BOOST_TICKS 100      /* Clock ticks between MLFQ priority boosts */
+
+#define STRIDE_ONE (1 << 16)      /* Stride of a process holding a single ticket */
+#define STRIDE_MAX_TICKETS 1000   /* Maximum tickets a process may hold */
+#define STRIDE_DEFAULT_TICKETS 100 /* Tickets given to newly created processes */
+
+#define RT_UTIL_SCALE 1000        /* Fixed point scale of real-time utilization, 1000 == 100% */
+
+/* Time quantum. Build with -DQUANTUM_DEFAULT_TICKS=<ticks> to change the boot default */
+
+#ifndef QUANTUM_DEFAULT_TICKS
+#define QUANTUM_DEFAULT_TICKS 1   /* Clock ticks a newly created process runs before rotating */
+#endif
+#define QUANTUM_MAX_TICKS 100     /* Largest quantum syssetquantum accepts */
+
+/* Build with -DIPC_FASTPATH=0 to always go through the ready queue after a recv blocks */
+
+#ifndef IPC_FASTPATH
+#define IPC_FASTPATH 1            /* Hand the cpu straight to the partner a blocking recv waits on */
+#endif
+
+/* Build with -DSTACK_POOL_SIZE=0 to give every stack back to the page allocator */
+
+#ifndef STACK_POOL_SIZE
+#define STACK_POOL_SIZE 16        /* Default sized stacks kept for reuse */
+#endif
 
 /* dispatcher constants */
 
 #define SYSCALL_INT_NUM 255     /* Interrupt number for syscalls */
+#define SYSCALL_MAX_ARGS 5      /* Syscall arguments are passed in ebx, ecx, edx, esi and edi */
+#define SYSCALL_ENTRY_INT 0      /* Enter the kernel through the SYSCALL_INT_NUM gate */
+#define SYSCALL_ENTRY_SYSENTER 1 /* Enter the kernel with sysenter */
+#define KERNEL_CODE_SEL 0x8     /* Kernel code segment selector, the data segment follows it */
+#define SYSRING_SIZE 1024       /* Entries in each queue of a syscall ring, a power of two */
+#define MAILBOX_MSG_MAX 64      /* Largest message a mailbox slot holds */
+#define MAILBOX_MAX_DEPTH 256   /* Most slots a mailbox can have */
+#define REGION_TABLE_SIZE 64    /* Regions that can exist at once */
 #define TIMER_INT_NUM 32       /* Interrupt number for timer */
 #define KEYBOARD_INT_NUM 33       /* Interrupt number for keyboard */
 
@@ -55,8 +109,19 @@ typedef unsigned int pid_t;  /* Typedef to represent process id's */
 #define INVALID_SIGNAL -1
 #define SYSHANDLER_NEWHANDLER_INVALID -2
 #define SYSHANDLER_OLDHANDLER_INVALID -3
+#define SYSHANDLER_NO_MEMORY -4
 #define SYSKILL_TARGET_DNE -512
 #define SYSKILL_SIG_INVALID -561
+#define SYSPRIO_INVALID -2
+#define SYSTICKETS_INVALID -2
+#define SYSRT_INVALID -2
+#define SYSRT_REJECTED -3
+#define SYSQUANTUM_INVALID -2
+#define SYSRING_OP_INVALID -2     /* Completion result of a request that can't be batched */
+#define SYSMAILBOX_INVALID -2
+#define SYSMAILBOX_NO_MEMORY -4
+#define SYSMAILBOX_NONE -6        /* The receiver of syssend_async has no mailbox */
+#define SYSREGION_NOT_OWNER -4    /* The caller does not own a region starting there */
 
 /* If a process is currently blocked on a syscall, and recieves a signal,
  * the process will be unblocked and the return value for the syscall will be this constant. */
@@ -98,6 +163,7 @@ typedef void (*funcptr)(void);
 typedef void (*funcptr_args)(void*);
 
 typedef struct pcb pcb_t; /* Forward declare this for the devsw table */
+typedef struct pcb_queue pcb_queue_t; /* Defined in pcb.h, pcbs embed queues of processes blocked on them */
 
 /* Structs and enums */
 
@@ -109,14 +175,94 @@ typedef enum proc_state {
     PROC_STATE_BLOCKED
 } proc_state_t;
 
+typedef struct struct_ss schedStatuses;
+struct struct_ss {
+    int policy;                        // The SCHED_POLICY the kernel was built with
+    long levelTicks[PRIORITY_LEVELS];  // Clock ticks spent running at each priority level
+    long demotions;                    // Processes demoted for using their whole quantum
+    long promotions;                   // Processes promoted for blocking
+    long boosts;                       // Number of periodic priority boosts
+    int rtUtilization;                 // Admitted real-time utilization out of RT_UTIL_SCALE
+    long rtMisses;                     // Real-time deadlines missed by all processes
+    long ticksAvoided;                 // Clock ticks accounted without a timer interrupt
+    long involuntarySwitches;          // Processes switched out by the timer
+    long skippedReschedules;           // Expired quanta renewed because nothing else could run
+    long ipcHandoffs;                  // Blocking recvs that switched straight to their partner
+};
+
 typedef struct struct_ps processStatuses;
 struct struct_ps {
     int entries;                  // Last entry used in the table
     int pid[PCB_TABLE_SIZE];      // The process ID
     int status[PCB_TABLE_SIZE];   // The process status
     long cpuTime[PCB_TABLE_SIZE]; // CPU time used in milliseconds
+    int priority[PCB_TABLE_SIZE]; // The scheduling priority
+    int deadlineMisses[PCB_TABLE_SIZE]; // Real-time deadlines missed
+    long involuntarySwitches[PCB_TABLE_SIZE]; // Times switched out by the timer
+};
+
+typedef struct struct_ms mailboxStatuses;
+struct struct_ms {
+    int depth;                    // Slots in the mailbox
+    int queued;                   // Messages waiting in it now
+    int maxQueued;                // Most messages ever waiting at once
+    long delivered;               // Messages taken out by a recv
+    long rejected;                // Sends refused with BLOCKERR because the mailbox was full
+    long dropped;                 // Messages discarded when the mailbox was replaced
 };
 
+typedef struct mailbox mailbox_t; /* Defined in msg.c */
+
+/* The message a process receives when a region is sent to it */
+typedef struct region {
+    void *base;                   // Start of the region, now owned by the receiver
+    int len;                      // Bytes in the region
+} region_t;
+
+/* A request submitted through a syscall ring */
+typedef struct sysring_sqe {
+    int request;                           // The syscall_request_t to run
+    unsigned long args[SYSCALL_MAX_ARGS];  // Its arguments, as passed to syscall()
+    unsigned long user_data;               // Copied to the completion untouched
+} sysring_sqe_t;
+
+/* The result of a request run from a syscall ring */
+typedef struct sysring_cqe {
+    unsigned long user_data;               // user_data of the request
+    int result;                            // What the syscall would have returned
+} sysring_cqe_t;
+
+/* Submission and completion queues shared between a process and the kernel.
+ * The indices run freely and are taken modulo SYSRING_SIZE. The process
+ * advances sq_tail and cq_head, the kernel sq_head and cq_tail. */
+typedef struct sysring {
+    unsigned int sq_head;
+    unsigned int sq_tail;
+    unsigned int cq_head;
+    unsigned int cq_tail;
+    sysring_sqe_t sq[SYSRING_SIZE];
+    sysring_cqe_t cq[SYSRING_SIZE];
+} sysring_t;
+
+/* A process as published in the kernel info page */
+typedef struct kernel_info_proc {
+    pid_t pid;
+    int status;                        // state + blocked_status, as shown by ps
+    unsigned long cpu_time;            // Clock ticks spent running
+    int priority;
+    int rt_misses;
+    long involuntary_switches;
+} kernel_info_proc_t;
+
+/* State the kernel publishes for user code to read without a trap */
+typedef struct kernel_info {
+    unsigned long generation;          // Bumped every time the kernel returns to a process
+    pid_t current_pid;                 // The running process
+    unsigned long clock_ticks;         // Clock ticks since the system started
+    kernel_info_proc_t idle;           // The idle process
+    kernel_info_proc_t procs[PCB_TABLE_SIZE]; // Indexed like the pcb table
+} kernel_info_t;
+
 /* Represent blocked status */
 typedef enum blocked_status {
     BLOCKED_STATUS_NONE,
@@ -124,7 +270,8 @@ typedef enum blocked_status {
     BLOCKED_STATUS_RECEIVE,
     BLOCKED_STATUS_WAITING,
     BLOCKED_STATUS_SLEEP,
-    BLOCKED_STATUS_DEVICE
+    BLOCKED_STATUS_DEVICE,
+    BLOCKED_STATUS_PERIOD
 } blocked_status_t;
 
 /* Device driver struct */
@@ -164,15 +311,57 @@ typedef struct pcb {
     pid_t blocked_id;    /* the PID of what this PCB is waiting for */
     blocked_status_t blocked_status; /* Status of which it is blocked */
     struct pcb *next;    /* Pointer to next PCB */
+    struct pcb *prev;    /* Pointer to previous PCB */
+    pcb_queue_t *queue;  /* The queue this PCB is on, null if none */
+    pcb_queue_t *senders;   /* Processes blocked sending to this process, FIFO */
+    pcb_queue_t *receivers; /* Processes blocked receiving from this process */
+    pcb_queue_t *waiters;   /* Processes blocked in syswait on this process */
+    pid_t ipc_partner;   /* Process this one's last send made ready, the handoff target of a recv from anyone right after it, 0 if none */
+    void *ipc_send_buf;  /* Message of a blocked send */
+    int ipc_send_len;    /* Length of the message of a blocked send */
+    void *ipc_recv_buf;  /* Buffer of a blocked recv */
+    int ipc_recv_len;    /* Length of the buffer of a blocked recv */
+    pid_t *ipc_from_pid; /* Where a blocked recv stores the sender's pid, may be null */
+    bool ipc_call;       /* The blocked send is the request of a sendrecv */
+    mailbox_t *mailbox;  /* Messages sent with syssend_async, null if the process has no mailbox */
+    sysring_t *ring;     /* Syscall ring registered by sysringsetup, null if none */
+    bool ring_parked;    /* A ring request blocked, the rest of its batch waits for it */
+    int ring_done;       /* Ring requests completed in the current sysringenter */
     
     void *stack_start;   /* The start of the stack memory allocated to this pcb */
+    int stack_order;     /* The stack is a block of 2^stack_order pages */
     void *esp;           /* Current location of the stack pointer */
     int ret;             /* Return value of the process */
+    unsigned long wake_tick; /* Clock tick a sleeping process wakes on, or its send or recv times out on */
+    struct pcb *timer_next;  /* Next pcb in the same timing wheel slot */
+    struct pcb *timer_prev;  /* Previous pcb in the same timing wheel slot */
+    struct pcb **timer_slot; /* Timing wheel slot the pcb is in, null if none */
+    unsigned long long wake_ns; /* clock_ns() a process in sysusleep wakes at */
     int cpu_time;        /* Total time this process has executed for */
-    long args;           /* Syscall arguments */
+    int priority;        /* Scheduling priority, PRIORITY_HIGHEST runs first */
+    int base_priority;   /* Priority set by syssetprio, restored on MLFQ boost */
+    int tickets;         /* Share of the cpu under the stride policy */
+    unsigned long stride; /* STRIDE_ONE / tickets, added to pass per tick used */
+    unsigned long pass;  /* Virtual time, the lowest pass runs next under stride */
+    int heap_index;      /* Position in the stride ready heap */
+    int quantum;         /* Clock ticks to run before the timer rotates to another process */
+    int quantum_left;    /* Clock ticks left of the current quantum */
+    long involuntary_switches; /* Times switched out by the timer */
+
+    /* Real-time (EDF) class, all in clock ticks. rt_period is 0 for normal processes */
+    unsigned int rt_period;       /* Time between job releases */
+    unsigned int rt_budget;       /* Cpu time each job may use */
+    unsigned int rt_deadline;     /* Deadline of each job relative to its release */
+    unsigned long rt_release;     /* Release time of the current job */
+    unsigned long rt_abs_deadline; /* Absolute deadline of the current job */
+    unsigned int rt_budget_left;  /* Budget remaining for the current job */
+    bool rt_job_done;             /* Current job completed by sysyield */
+    bool rt_job_missed;           /* Current job already counted as a deadline miss */
+    int rt_misses;                /* Number of deadlines missed */
+    unsigned long args[SYSCALL_MAX_ARGS]; /* Syscall arguments, decoded from the registers on entry */
 
     /* Signals */
-    funcptr_args *signal_table;  /* pointer to the signal table */
+    funcptr_args *signal_table;  /* pointer to the signal table, null until a handler is set */
     unsigned int signals_enabled;         /* signals currently enabled for this process */
     unsigned int signals_pending;         /* signals pending to be processed by this process */
 
@@ -214,8 +403,32 @@ typedef enum request {
     SYSCALL_WRITE,
     SYSCALL_READ,
     SYSCALL_IOCTL,
+    SYSCALL_SETPRIO,
+    SYSCALL_GETPRIO,
+    SYSCALL_SCHEDSTATS,
+    SYSCALL_SETTICKETS,
+    SYSCALL_SETRT,
+    SYSCALL_SETQUANTUM,
+    SYSCALL_SENDRECV,
+    SYSCALL_REPLYWAIT,
+    SYSCALL_RINGSETUP,
+    SYSCALL_RINGENTER,
+    SYSCALL_CREATEMANY,
+    SYSCALL_GETTIMENS,
+    SYSCALL_USLEEP,
+    SYSCALL_SENDTIM,
+    SYSCALL_RECVTIM,
+    SYSCALL_SENDNB,
+    SYSCALL_RECVNB,
+    SYSCALL_SENDASYNC,
+    SYSCALL_MAILBOX,
+    SYSCALL_MAILBOXSTATS,
+    SYSCALL_REGIONALLOC,
+    SYSCALL_REGIONFREE,
+    SYSCALL_SENDREGION,
     TIMER_INT,
-    KEYBOARD_INT
+    KEYBOARD_INT,
+    NUM_REQUESTS
 } syscall_request_t;
 
 /* Memory manager functions */
@@ -223,7 +436,18 @@ typedef enum request {
 extern void kmeminit(void);
 extern void *kmalloc(size_t size);
 extern int kfree(void *ptr);
+extern void *kpage_alloc(int order);
+extern int kpage_free(void *page);
+extern int kpage_order(size_t size);
 extern void mem_dump(void);
+
+/* Object cache functions */
+
+typedef struct kmem_cache kmem_cache_t;
+extern kmem_cache_t *kmem_cache_create(char *name, size_t size, size_t align);
+extern void *kmem_cache_alloc(kmem_cache_t *cache);
+extern void kmem_cache_free(kmem_cache_t *cache, void *obj);
+extern void kmem_cache_dump(void);
 extern int verify_sysptr(void *ptr, long len);
 
 /* Dispatcher functions */
@@ -233,23 +457,63 @@ extern void dispatch(void);
 extern void *next(void);
 extern void ready(void *proc);
 
+/* Scheduling policy functions */
+
+extern void sched_tick(pcb_t *pcb);
+extern bool sched_quantum_tick(pcb_t *pcb);
+extern void sched_preempted(pcb_t *pcb);
+extern pcb_t *sched_handoff(pcb_t *from, pcb_t *to);
+extern void sched_blocked(pcb_t *pcb);
+extern void sched_set_tickets(pcb_t *pcb, int tickets);
+extern int sched_rt_admit(pcb_t *pcb, unsigned int period, unsigned int budget, unsigned int deadline);
+extern void sched_rt_leave(pcb_t *pcb);
+extern void sched_rt_job_done(pcb_t *pcb);
+extern void sched_rt_missed(pcb_t *pcb);
+extern bool sched_rt_active(void);
+extern void fill_schedStatus(schedStatuses *ss);
+extern void dump_sched_stats(void);
+
 /* Context switching functions */
 
+extern int syscall_entry;
+extern const volatile kernel_info_t *kernel_info;
 extern void contextinit(void);
 extern syscall_request_t contextswitch(pcb_t *proc);
 
+/* Kernel info page functions */
+
+extern void kinfo_init(void);
+extern void kinfo_publish_pcb(pcb_t *pcb);
+extern void kinfo_switch(pcb_t *pcb);
+
 /* System call functions */
 
-extern int syscall(int call, ...);
+extern int syscall(int call, int nargs, ...);
 extern unsigned int syscreate(void(*func)(void), int stack);
+extern int syscreate_many(void(*func)(void), int stack, int n, pid_t *pids);
 extern void sysyield(void);
 extern void sysstop(void);
 extern pid_t sysgetpid(void);
+extern unsigned long sysgetticks(void);
 extern void sysputs(char *str);
 extern int syskill(pid_t pid, int signalNumber);
 extern int syssend(pid_t dest_pid, void *buffer, int buffer_len);
 extern int sysrecv(pid_t *from_pid, void *buffer, int buffer_len);
+extern int syssendtim(pid_t dest_pid, void *buffer, int buffer_len, unsigned int milliseconds);
+extern int sysrecvtim(pid_t *from_pid, void *buffer, int buffer_len, unsigned int milliseconds);
+extern int syssend_nb(pid_t dest_pid, void *buffer, int buffer_len);
+extern int sysrecv_nb(pid_t *from_pid, void *buffer, int buffer_len);
+extern int syssend_async(pid_t dest_pid, void *buffer, int buffer_len);
+extern int sysmailbox(int depth);
+extern int sysmailboxstats(mailboxStatuses *ms);
+extern void *sysregionalloc(int len);
+extern int sysregionfree(void *base);
+extern int syssend_region(pid_t dest_pid, void *base);
+extern int syssendrecv(pid_t dest_pid, void *send_buffer, int send_len, void *recv_buffer, int recv_len);
+extern int sysreplywait(pid_t *client_pid, void *reply, int reply_len, void *buffer, int buffer_len);
 extern unsigned int syssleep(unsigned int milliseconds);
+extern unsigned int sysusleep(unsigned int microseconds);
+extern int sysgettime_ns(unsigned long long *ns);
 extern int sysgetcputimes(processStatuses *ps);
 extern int syssighandler(int signal, funcptr_args newHandler, funcptr_args *oldHandler);
 extern void syssigreturn(void *old_sp);
@@ -259,6 +523,14 @@ extern int sysclose(int fd);
 extern int syswrite(int fd, void *buff, int bufflen);
 extern int sysread(int fd, void *buff, int bufflen);
 extern int sysioctl(int fd, unsigned long command, ...);
+extern int syssetprio(pid_t pid, int priority);
+extern int sysgetprio(pid_t pid);
+extern int sysgetschedstats(schedStatuses *ss);
+extern int syssettickets(pid_t pid, int tickets);
+extern int syssetrt(unsigned int period, unsigned int budget, unsigned int deadline);
+extern int syssetquantum(pid_t pid, int ticks);
+extern int sysringsetup(sysring_t *ring);
+extern int sysringenter(void);
 
 /* Device independant functions (used by disp) */
 
@@ -272,6 +544,7 @@ extern void di_init_devtable(void);
 /* Creating processes functions */
 
 extern int create(funcptr fp, int stack);
+extern void free_stack(void *stack_start, int stack_order);
 extern void init_context_frame(context_frame_t *context, funcptr fp);
 extern void root(void);
 extern int idleinit(void);
@@ -281,18 +554,51 @@ extern pcb_t *get_idleproc(void);
 /* Inter-process communication functions */
 
 extern int send(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len);
-extern int recv(pcb_t *from_pid, pcb_t *curr_proc, void *buffer, int buffer_len);
+extern int recv(pcb_t *from_proc, pcb_t *curr_proc, pid_t *from_pid, void *buffer, int buffer_len);
+extern int try_send(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len);
+extern int try_recv(pcb_t *from_proc, pcb_t *curr_proc, pid_t *from_pid, void *buffer, int buffer_len);
+extern int send_async(pcb_t *curr_proc, pcb_t *dest_proc, void *buffer, int buffer_len);
+extern int set_mailbox(pcb_t *pcb, int depth);
+extern int fill_mailboxStatus(pcb_t *pcb, mailboxStatuses *ms);
+extern void *region_alloc(pcb_t *pcb, int len);
+extern int region_free(pcb_t *pcb, void *base);
+extern region_t *region_owned(pcb_t *pcb, void *base);
+extern void region_transfer(pcb_t *sender, void *send_buffer, int len, pcb_t *receiver);
+extern void region_release_all(pcb_t *pcb);
+extern void sendrecv(pcb_t *curr_proc, pcb_t *dest_proc, void *send_buffer, int send_len,
+        void *recv_buffer, int recv_len);
+extern int replywait(pcb_t *curr_proc, pcb_t *client_proc, void *reply, int reply_len,
+        pid_t *from_pid, void *buffer, int buffer_len);
 
 /* Signal handler functions */
 
 extern void sigtramp(funcptr_args handler, void *cntx);
 extern int signal(pid_t pid, int signalNumber);
+extern funcptr_args get_signal_handler(pcb_t *pcb, int signal);
+extern int set_signal_handler(pcb_t *pcb, int signal, funcptr_args handler);
+extern funcptr_args *alloc_signal_table(void);
+extern void free_signal_table(funcptr_args *signal_table);
 
 /* Sleep process */
 
 extern void sleepinit(void);
 extern void sleep(pcb_t *pcb, unsigned int milliseconds);
+extern void usleep(pcb_t *pcb, unsigned int microseconds);
+extern void set_timeout(pcb_t *pcb, unsigned int milliseconds);
+extern void cancel_timeout(pcb_t *pcb);
+extern bool hrtimer_interrupt(void);
 extern void tick(void);
+extern unsigned long get_clock_ticks(void);
+extern int tickless_enter(void);
+extern int tickless_exit(bool timer_fired);
+extern long get_ticks_avoided(void);
 extern void wake(pcb_t *pcb);
 
+/* Clock source */
+
+extern void clock_init(void);
+extern unsigned long long clock_ns(void);
+extern bool clock_hires(void);
+extern unsigned long clock_ns_to_us(unsigned long long ns);
+
 #endif